@@ -0,0 +1,178 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	KSyms.c
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Turn the kernel's name list into an assembly-language
+**		symbol table, which is linked into the kernel so that
+**		_kpanic() can print a symbolic traceback.
+**
+**		The name list is "nm -n" output, read from a file or
+**		the standard input; only the text symbols are kept.
+**		An empty name list (/dev/null) makes an empty table,
+**		for the first link.  The table is read-only data linked
+**		after everything else, so adding it doesn't move any
+**		text symbol.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define	TRUE	1
+#define	FALSE	0
+
+#define	MAX_LINE	512
+
+char	*progname;		/* invocation name of this program */
+
+/*
+** Text symbols from the name list, sorted by address
+*/
+typedef struct symbol {
+	unsigned long	addr;
+	char		*name;
+} symbol_t;
+
+symbol_t	*symbols;
+int		n_symbols;
+int		max_symbols;
+
+void quit( char *msg, int call_perror ) {
+	if( msg != NULL ){
+		fprintf( stderr, "%s: ", progname );
+		if( call_perror ){
+			perror( msg );
+		}
+		else {
+			fprintf( stderr, "%s\n", msg );
+		}
+	}
+	exit( EXIT_FAILURE );
+}
+
+char	usage_error_msg[] =
+  "\nUsage: %s [ namelist ]\n\n"
+  "\t'namelist' is the output of 'nm -n prog.o' (read from the standard\n"
+  "\tinput if it isn't given).  The symbol table is written to the\n"
+  "\tstandard output.\n\n";
+
+void usage_error( void ){
+	fprintf( stderr, usage_error_msg, progname );
+	quit( NULL, FALSE );
+}
+
+void *grow( void *array, int *max, size_t size ){
+	*max = *max ? *max * 2 : 256;
+	array = realloc( array, *max * size );
+	if( array == NULL ){
+		quit( "out of memory", FALSE );
+	}
+	return array;
+}
+
+int by_address( const void *a, const void *b ){
+	const symbol_t	*sa = a, *sb = b;
+
+	return sa->addr < sb->addr ? -1 : sa->addr > sb->addr;
+}
+
+/*
+** Read the text symbols from the name list:  "nm -n" output, one
+** "address type name" symbol per line.  (The printable listings,
+** prog.nl and prog.nlf, won't do; pr cuts the names short.)
+*/
+void read_namelist( FILE *in ){
+	char		line[ MAX_LINE ];
+	char		name[ MAX_LINE ];
+	unsigned long	addr;
+	char		type;
+
+	while( fgets( line, sizeof( line ), in ) != NULL ){
+		if( sscanf( line, "%lx %c %511s", &addr, &type, name ) != 3 ){
+			continue;
+		}
+		if( type != 'T' && type != 't' ){
+			continue;
+		}
+
+		if( n_symbols == max_symbols ){
+			symbols = grow( symbols, &max_symbols,
+					sizeof( symbol_t ) );
+		}
+		symbols[ n_symbols ].addr = addr;
+		symbols[ n_symbols ].name = strdup( name );
+		++n_symbols;
+	}
+
+	fclose( in );
+
+	qsort( symbols, n_symbols, sizeof( symbol_t ), by_address );
+}
+
+/*
+** Write the table:  the count, then (address, name) pairs in
+** address order, then the names
+*/
+void write_table( void ){
+	int	i;
+
+	printf( "/*\n** Kernel symbol table - generated by %s; do not edit\n*/\n\n",
+		progname );
+	printf( "\t.section\t.rodata\n\n" );
+
+	printf( "\t.globl\t_ksym_count\n" );
+	printf( "\t.align\t4\n" );
+	printf( "_ksym_count:\n\t.long\t%d\n\n", n_symbols );
+
+	printf( "\t.globl\t_ksyms\n" );
+	printf( "_ksyms:\n" );
+	for( i = 0; i < n_symbols; ++i ){
+		printf( "\t.long\t0x%08lx, .Lname%d\n", symbols[ i ].addr, i );
+	}
+
+	printf( "\n" );
+	for( i = 0; i < n_symbols; ++i ){
+		printf( ".Lname%d:\t.asciz\t\"%s\"\n", i, symbols[ i ].name );
+	}
+}
+
+int main( int ac, char **av ) {
+	FILE	*in = stdin;
+
+	/*
+	** Save the program name for error messages
+	*/
+	progname = strrchr( av[ 0 ], '/' );
+	if( progname != NULL ){
+		progname++;
+	}
+	else {
+		progname = av[ 0 ];
+	}
+
+	/*
+	** Process arguments
+	*/
+	++av; --ac;
+	if( ac > 1 ){
+		usage_error();
+	}
+
+	if( ac == 1 ){
+		in = fopen( av[ 0 ], "r" );
+		if( in == NULL ){
+			quit( av[ 0 ], TRUE );
+		}
+	}
+
+	read_namelist( in );
+
+	write_table();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,390 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	ProfSym.c
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Turn a dump from the kernel's sampling profiler into
+**		a symbolic profile.
+**
+**		The dump (read from FD_PROF, typically captured from
+**		the serial line) is matched against the kernel's name
+**		list, prog.sym (plain "nm -n" output).
+**		By default, a flat profile of samples per function and
+**		per PID is printed; with -f, the call chains of the
+**		recent samples are printed as folded stacks, suitable
+**		for flamegraph.pl.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define	TRUE	1
+#define	FALSE	0
+
+#define	MAX_LINE	512
+#define	MAX_DEPTH	16
+
+char	*progname;		/* invocation name of this program */
+int	folded = FALSE;		/* print folded stacks? */
+
+/*
+** Text symbols from the name list, sorted by address
+*/
+typedef struct symbol {
+	unsigned long	addr;
+	char		*name;
+	unsigned long	count;		/* flat profile samples */
+} symbol_t;
+
+symbol_t	*symbols;
+int		n_symbols;
+int		max_symbols;
+
+/*
+** Folded stacks, before merging
+*/
+char		**stacks;
+int		n_stacks;
+int		max_stacks;
+
+/*
+** Totals from the dump
+*/
+unsigned long	total;		/* samples taken */
+unsigned long	other;		/* samples outside the kernel text */
+unsigned long	unknown;	/* samples with no matching symbol */
+
+#define	MAX_PIDS	256
+unsigned long	pids[ MAX_PIDS ][ 2 ];	/* PID and its samples */
+int		n_pids;
+
+void quit( char *msg, int call_perror ) {
+	if( msg != NULL ){
+		fprintf( stderr, "%s: ", progname );
+		if( call_perror ){
+			perror( msg );
+		}
+		else {
+			fprintf( stderr, "%s\n", msg );
+		}
+	}
+	exit( EXIT_FAILURE );
+}
+
+char	usage_error_msg[] =
+  "\nUsage: %s [ -f ] namelist [ dump_file ]\n\n"
+  "\t'namelist' is prog.sym (the output of 'nm -n prog.o').\n"
+  "\tThe profiler dump is read from 'dump_file', or from the standard\n"
+  "\tinput; anything in it which isn't part of the dump is ignored.\n\n"
+  "\tWithout -f, prints the samples per function and per PID.  With\n"
+  "\t-f, prints the recent samples as folded call stacks.\n\n";
+
+void usage_error( void ){
+	fprintf( stderr, usage_error_msg, progname );
+	quit( NULL, FALSE );
+}
+
+void *grow( void *array, int *max, size_t size ){
+	*max = *max ? *max * 2 : 256;
+	array = realloc( array, *max * size );
+	if( array == NULL ){
+		quit( "out of memory", FALSE );
+	}
+	return array;
+}
+
+int by_address( const void *a, const void *b ){
+	const symbol_t	*sa = a, *sb = b;
+
+	return sa->addr < sb->addr ? -1 : sa->addr > sb->addr;
+}
+
+int by_count( const void *a, const void *b ){
+	const symbol_t	*sa = a, *sb = b;
+
+	return sa->count > sb->count ? -1 : sa->count < sb->count;
+}
+
+int by_string( const void *a, const void *b ){
+	return strcmp( *(char * const *) a, *(char * const *) b );
+}
+
+/*
+** Read the text symbols from the name list:  "nm -n" output, one
+** "address type name" symbol per line.  (The printable listings,
+** prog.nl and prog.nlf, won't do; pr cuts the names short.)
+*/
+void read_namelist( char *file ){
+	FILE		*in;
+	char		line[ MAX_LINE ];
+	char		name[ MAX_LINE ];
+	unsigned long	addr;
+	char		type;
+
+	in = fopen( file, "r" );
+	if( in == NULL ){
+		quit( file, TRUE );
+	}
+
+	while( fgets( line, sizeof( line ), in ) != NULL ){
+		if( sscanf( line, "%lx %c %511s", &addr, &type, name ) != 3 ){
+			continue;
+		}
+		if( type != 'T' && type != 't' ){
+			continue;
+		}
+
+		if( n_symbols == max_symbols ){
+			symbols = grow( symbols, &max_symbols,
+					sizeof( symbol_t ) );
+		}
+		symbols[ n_symbols ].addr = addr;
+		symbols[ n_symbols ].name = strdup( name );
+		symbols[ n_symbols ].count = 0;
+		++n_symbols;
+	}
+
+	fclose( in );
+
+	if( n_symbols == 0 ){
+		fprintf( stderr, "%s: no text symbols in %s\n", progname, file );
+		quit( NULL, FALSE );
+	}
+
+	qsort( symbols, n_symbols, sizeof( symbol_t ), by_address );
+}
+
+/*
+** Find the symbol containing 'addr'
+*/
+symbol_t *lookup( unsigned long addr ){
+	int	lo = 0, hi = n_symbols - 1, mid;
+
+	if( addr < symbols[ 0 ].addr ){
+		return NULL;
+	}
+
+	while( lo < hi ){
+		mid = ( lo + hi + 1 ) / 2;
+		if( symbols[ mid ].addr <= addr ){
+			lo = mid;
+		}
+		else {
+			hi = mid - 1;
+		}
+	}
+
+	return &symbols[ lo ];
+}
+
+/*
+** Record one sample's call chain as a folded stack:  the PID, then
+** the callers from the outermost in, then the interrupted function
+*/
+void add_stack( char *fields ){
+	unsigned long	pc[ MAX_DEPTH ];
+	char		buf[ MAX_LINE * 2 ];
+	char		*end;
+	symbol_t	*sym;
+	unsigned long	pid;
+	int		depth = 0;
+	int		len;
+
+	pid = strtoul( fields, &end, 16 );
+	if( end == fields ){
+		return;
+	}
+
+	while( depth < MAX_DEPTH ){
+		fields = end;
+		pc[ depth ] = strtoul( fields, &end, 16 );
+		if( end == fields ){
+			break;
+		}
+		++depth;
+	}
+	if( depth == 0 ){
+		return;
+	}
+
+	len = sprintf( buf, "pid %lu", pid );
+	while( depth-- > 0 ){
+		/*
+		** A return address may be just past the end of the
+		** calling function, so look up the call instruction
+		*/
+		sym = lookup( depth > 0 ? pc[ depth ] - 1 : pc[ depth ] );
+		if( len + MAX_LINE + 20 > (int) sizeof( buf ) ){
+			break;
+		}
+		if( sym != NULL ){
+			len += sprintf( buf + len, ";%s", sym->name );
+		}
+		else {
+			len += sprintf( buf + len, ";0x%08lx", pc[ depth ] );
+		}
+	}
+
+	if( n_stacks == max_stacks ){
+		stacks = grow( stacks, &max_stacks, sizeof( char * ) );
+	}
+	stacks[ n_stacks++ ] = strdup( buf );
+}
+
+/*
+** Read the profiler dump
+*/
+void read_dump( FILE *in ){
+	char		line[ MAX_LINE ];
+	char		*end;
+	unsigned long	a, b;
+	symbol_t	*sym;
+	int		in_dump = FALSE;
+
+	while( fgets( line, sizeof( line ), in ) != NULL ){
+		if( line[ 0 ] == '\0' ||
+		    ( line[ 1 ] != ' ' && line[ 1 ] != '\n' ) ){
+			continue;
+		}
+
+		/*
+		** Only the last complete dump counts
+		*/
+		if( line[ 0 ] == 'T' ){
+			in_dump = TRUE;
+			total = other = unknown = 0;
+			n_pids = 0;
+			for( int i = 0; i < n_symbols; ++i ){
+				symbols[ i ].count = 0;
+			}
+			while( n_stacks > 0 ){
+				free( stacks[ --n_stacks ] );
+			}
+			continue;
+		}
+		if( !in_dump ){
+			continue;
+		}
+
+		a = strtoul( line + 1, &end, 16 );
+		b = strtoul( end, NULL, 16 );
+
+		switch( line[ 0 ] ){
+		case 'N':
+			total = a;
+			other = b;
+			break;
+
+		case 'P':
+			if( n_pids < MAX_PIDS ){
+				pids[ n_pids ][ 0 ] = a;
+				pids[ n_pids ][ 1 ] = b;
+				++n_pids;
+			}
+			break;
+
+		case 'B':
+			sym = lookup( a );
+			if( sym != NULL ){
+				sym->count += b;
+			}
+			else {
+				unknown += b;
+			}
+			break;
+
+		case 'S':
+			add_stack( line + 1 );
+			break;
+
+		case 'E':
+			in_dump = FALSE;
+			break;
+		}
+	}
+}
+
+void print_flat( void ){
+	qsort( symbols, n_symbols, sizeof( symbol_t ), by_count );
+
+	printf( "\n%lu samples, %lu outside the kernel text, %lu unknown\n\n",
+		total, other, unknown );
+	for( int i = 0; i < n_pids; ++i ){
+		printf( "pid %5lu %10lu samples\n", pids[ i ][ 0 ], pids[ i ][ 1 ] );
+	}
+
+	printf( "\n     %%    samples  function\n" );
+
+	for( int i = 0; i < n_symbols && symbols[ i ].count > 0; ++i ){
+		printf( "%6.2f %10lu  %s\n",
+			total ? 100.0 * symbols[ i ].count / total : 0.0,
+			symbols[ i ].count, symbols[ i ].name );
+	}
+}
+
+void print_folded( void ){
+	int	i, j;
+
+	qsort( stacks, n_stacks, sizeof( char * ), by_string );
+
+	for( i = 0; i < n_stacks; i = j ){
+		for( j = i + 1; j < n_stacks; ++j ){
+			if( strcmp( stacks[ i ], stacks[ j ] ) != 0 ){
+				break;
+			}
+		}
+		printf( "%s %d\n", stacks[ i ], j - i );
+	}
+}
+
+int main( int ac, char **av ) {
+	FILE	*in = stdin;
+
+	/*
+	** Save the program name for error messages
+	*/
+	progname = strrchr( av[ 0 ], '/' );
+	if( progname != NULL ){
+		progname++;
+	}
+	else {
+		progname = av[ 0 ];
+	}
+
+	/*
+	** Process arguments
+	*/
+	++av; --ac;
+	if( ac > 0 && strcmp( av[ 0 ], "-f" ) == 0 ){
+		folded = TRUE;
+		++av; --ac;
+	}
+	if( ac < 1 || ac > 2 ){
+		usage_error();
+	}
+
+	read_namelist( av[ 0 ] );
+
+	if( ac == 2 ){
+		in = fopen( av[ 1 ], "r" );
+		if( in == NULL ){
+			quit( av[ 1 ], TRUE );
+		}
+	}
+
+	read_dump( in );
+
+	if( folded ){
+		print_folded();
+	}
+	else {
+		print_flat();
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -40,18 +40,91 @@ unsigned int	max_x, max_y;
 #include <stdio.h>
 #define	c_putchar	putchar
 #define	c_puts(x)	fputs( x, stdout )
+#define	__c_putc	putchar
+#define	__c_puts(x)	fputs( x, stdout )
 #endif
 
-#define	VIDEO_ADDR(x,y)	( unsigned short * ) ( unsigned long ) \
-		( VIDEO_BASE_ADDR + 2 * ( (y) * SCREEN_X_SIZE + (x) ) )
+/*
+** All output goes to a shadow copy of the screen in RAM, and rows
+** which have changed are marked in 'dirty'.  c_flush() copies the
+** dirty rows to the video memory (which is slow to write, especially
+** under emulation) and moves the hardware cursor; the kernel calls
+** it periodically from deferred work.  In headless mode, nothing is
+** ever copied.
+**
+** There are C_CONSOLES virtual consoles, each with its own shadow
+** screen, scroll region, cursor and keyboard input buffer; only the
+** one 'shown' is copied to the screen.  Keystrokes go to the 'focus'
+** console.  The routines here work on the 'current' console, whose
+** scroll region, cursor and dirty rows are kept in the variables
+** above and below while it is current; __c_select() changes it.
+** Alt-F1 through Alt-Fn give console 0 through n-1 the focus at
+** once; the next c_flush() shows it.
+*/
+#define	C_BUFSIZE	200
+
+typedef struct __c_console {
+	unsigned short	cells[ SCREEN_Y_SIZE * SCREEN_X_SIZE ];
+	unsigned int	dirty;
+	unsigned int	scroll_min_x, scroll_min_y;
+	unsigned int	scroll_max_x, scroll_max_y;
+	unsigned int	curr_x, curr_y;
+	/*
+	** Circular buffer for input characters.  Characters are
+	** inserted at next_space, and are removed at next_char.
+	** Buffer is empty if these are equal.
+	*/
+	char		input[ C_BUFSIZE ];
+	volatile char	*next_char;
+	volatile char	*next_space;
+} __c_console_t;
+
+static __c_console_t	consoles[ C_CONSOLES ];
+static __c_console_t	*current = &consoles[ 0 ];
+static __c_console_t	*shown = &consoles[ 0 ];
+static __c_console_t	* volatile focus = &consoles[ 0 ];
+
+static unsigned short	*shadow = consoles[ 0 ].cells;
+static unsigned int	dirty;		/* one bit per row */
+static unsigned int	cursor_moved;
+#ifdef CONSOLE_HEADLESS
+static int		headless = 1;
+#else
+static int		headless;
+#endif
+
+#define	SHADOW_ADDR(x,y)	( &shadow[ (y) * SCREEN_X_SIZE + (x) ] )
+#define	ALL_ROWS	( ( 1u << SCREEN_Y_SIZE ) - 1 )
+#define	ROWS(first,last) ( ( ( 2u << (last) ) - 1 ) & ~( ( 1u << (first) ) - 1 ) )
+
+/*
+** The screen shows SCREEN_Y_SIZE rows of the text memory starting
+** 'origin' cells in.  A full-width scroll region is scrolled on the
+** screen by moving the origin; 'pending' counts the lines it has
+** been scrolled in the shadow since the last c_flush().  See
+** c_scroll().
+*/
+#define	VIDEO_CELLS	16384		/* 32KB of text memory */
+
+static unsigned int	origin;
+static unsigned int	pending;
+
+#define	CELL_ADDR(o,x,y) ( unsigned short * ) ( unsigned long ) \
+		( VIDEO_BASE_ADDR + 2 * ( (o) + (y) * SCREEN_X_SIZE + (x) ) )
+
+#define	BLANK		( ' ' | 0x0700 )
 
 /*
 ** Support routines.
 **
 ** bound: confine an argument within given bounds
-** __c_putchar_at: physical output to the video memory
-** __c_setcursor: set the cursor location (screen coordinates)
-** __c_strlen: compute the length of a string
+** __c_putchar_at: output to the shadow screen
+** __c_setcursor: note that the cursor location has changed
+** __c_showcursor: set the hardware cursor location
+**
+** The hardware cursor is only moved by c_flush(); the CRTC port
+** writes cost far more than the video memory writes, especially
+** under emulation.
 */
 static unsigned int bound( unsigned int min, unsigned int value, unsigned int max ){
 	if( value < min ){
@@ -63,7 +136,42 @@ static unsigned int bound( unsigned int min, unsigned int value, unsigned int ma
 	return value;
 }
 
+/*
+** __c_select: make 'vc' the current console, saving the state of
+** the old one
+*/
+static void __c_select( __c_console_t *vc ){
+	if( vc == current ){
+		return;
+	}
+
+	current->dirty = dirty;
+	current->scroll_min_x = scroll_min_x;
+	current->scroll_min_y = scroll_min_y;
+	current->scroll_max_x = scroll_max_x;
+	current->scroll_max_y = scroll_max_y;
+	current->curr_x = curr_x;
+	current->curr_y = curr_y;
+
+	current = vc;
+	shadow = vc->cells;
+	dirty = vc->dirty;
+	scroll_min_x = vc->scroll_min_x;
+	scroll_min_y = vc->scroll_min_y;
+	scroll_max_x = vc->scroll_max_x;
+	scroll_max_y = vc->scroll_max_y;
+	curr_x = vc->curr_x;
+	curr_y = vc->curr_y;
+}
+
 static void __c_setcursor( void ){
+	if( current == shown ){
+		cursor_moved = 1;
+	}
+}
+
+static void __c_showcursor( void ){
+	static unsigned	cursor = ~0u;	/* where the hardware has it */
 	unsigned addr;
 	unsigned int	y = curr_y;
 
@@ -71,21 +179,25 @@ static void __c_setcursor( void ){
 		y = scroll_max_y;
 	}
 
-	addr = (unsigned)( y * SCREEN_X_SIZE + curr_x );
+	addr = (unsigned)( origin + y * SCREEN_X_SIZE + curr_x );
 
-	__outb( 0x3d4, 0xe );
-	__outb( 0x3d5, ( addr >> 8 ) & 0xff );
-	__outb( 0x3d4, 0xf );
-	__outb( 0x3d5, addr & 0xff );
+	/*
+	** Only tell the CRTC if it moved; a word write sets the
+	** index and data registers together
+	*/
+	if( addr != cursor ){
+		__outw( 0x3d4, ( addr & 0xff00 ) | 0xe );
+		__outw( 0x3d4, ( ( addr & 0xff ) << 8 ) | 0xf );
+		cursor = addr;
+	}
 }
 
-static unsigned int __c_strlen( char const *str ){
-	unsigned int	len = 0;
-
-	while( *str++ != '\0' ){
-		len += 1;
-	}
-	return len;
+/*
+** __c_setorigin: point the CRTC start address at 'origin'
+*/
+static void __c_setorigin( void ){
+	__outw( 0x3d4, ( origin & 0xff00 ) | 0xc );
+	__outw( 0x3d4, ( ( origin & 0xff ) << 8 ) | 0xd );
 }
 
 static void __c_putchar_at( unsigned int x, unsigned int y, unsigned int c ){
@@ -93,7 +205,9 @@ static void __c_putchar_at( unsigned int x, unsigned int y, unsigned int c ){
 	** If x or y is too big or small, don't do any output.
 	*/
 	if( x <= max_x && y <= max_y ){
-		unsigned short *addr = VIDEO_ADDR( x, y );
+		unsigned short *addr = SHADOW_ADDR( x, y );
+
+		dirty |= 1u << y;
 
 		if( c > 0xff ) {
 			/*
@@ -110,6 +224,14 @@ static void __c_putchar_at( unsigned int x, unsigned int y, unsigned int c ){
 }
 
 void c_setscroll( unsigned int s_min_x, unsigned int s_min_y, unsigned int s_max_x, unsigned int s_max_y ){
+	/*
+	** A pending origin scroll applies to the old region, so just
+	** redraw everything instead
+	*/
+	if( pending && current == shown ){
+		pending = 0;
+		dirty = ALL_ROWS;
+	}
 	scroll_min_x = bound( min_x, s_min_x, max_x );
 	scroll_min_y = bound( min_y, s_min_y, max_y );
 	scroll_max_x = bound( scroll_min_x, s_max_x, max_x );
@@ -160,7 +282,7 @@ void c_putchar_at( unsigned int x, unsigned int y, unsigned int c ){
 }
 
 #ifndef SA_DEBUG
-void c_putchar( unsigned int c ){
+static void __c_putc( unsigned int c ){
 	/*
 	** If we're off the bottom of the screen, scroll the window.
 	*/
@@ -196,6 +318,10 @@ void c_putchar( unsigned int c ){
 		}
 		break;
 	}
+}
+
+void c_putchar( unsigned int c ){
+	__c_putc( c );
 	__c_setcursor();
 }
 #endif
@@ -213,56 +339,148 @@ void c_puts_at( unsigned int x, unsigned int y, char *str ){
 }
 
 #ifndef SA_DEBUG
-int c_puts( char *str ){
+static int __c_puts( char *str ){
 	unsigned int	ch;
 	int count = 0;
 
 	while( (ch = *str++) != '\0' ){
 		++count;
-		c_putchar( ch );
+		__c_putc( ch );
 	}
 
 	return( count );
 }
+
+int c_puts( char *str ){
+	int count;
+
+	count = __c_puts( str );
+	__c_setcursor();
+
+	return( count );
+}
 #endif
 
 void c_putbuf( char *str, int num ){
 
 	while( num-- ) {
-		c_putchar( *str++ );
+		__c_putc( *str++ );
+	}
+	__c_setcursor();
+}
+
+/*
+** Scrolling support.
+**
+** __c_copy and __c_fill move cells a longword (two cells) at a time;
+** the source and destination of a copy are always rows with the same
+** alignment.  A copy from higher to lower addresses may overlap.
+*/
+static void __c_copy( unsigned short *to, unsigned short *from, unsigned int n ){
+	unsigned int	*lto, *lfrom;
+
+	if( n > 0 && ( (unsigned long) to & 2 ) ){
+		*to++ = *from++;
+		n -= 1;
+	}
+	lto = (unsigned int *) to;
+	lfrom = (unsigned int *) from;
+	for( ; n >= 2; n -= 2 ){
+		*lto++ = *lfrom++;
+	}
+	if( n > 0 ){
+		*(unsigned short *) lto = *(unsigned short *) lfrom;
+	}
+}
+
+static void __c_fill( unsigned short *to, unsigned int n ){
+	unsigned int	*lto;
+
+	if( n > 0 && ( (unsigned long) to & 2 ) ){
+		*to++ = BLANK;
+		n -= 1;
+	}
+	lto = (unsigned int *) to;
+	for( ; n >= 2; n -= 2 ){
+		*lto++ = ( BLANK << 16 ) | BLANK;
+	}
+	if( n > 0 ){
+		*(unsigned short *) lto = BLANK;
 	}
 }
 
 void c_clearscroll( void ){
 	unsigned int	nchars = scroll_max_x - scroll_min_x + 1;
 	unsigned int	l;
-	unsigned int	c;
 
 	for( l = scroll_min_y; l <= scroll_max_y; l += 1 ){
-		unsigned short *to = VIDEO_ADDR( scroll_min_x, l );
-
-		for( c = 0; c < nchars; c += 1 ){
-			*to++ = ' ' | 0x0700;
-		}
+		__c_fill( SHADOW_ADDR( scroll_min_x, l ), nchars );
 	}
+	dirty |= ROWS( scroll_min_y, scroll_max_y );
 }
 
 void c_clearscreen( void ){
-	unsigned short *to = VIDEO_ADDR( min_x, min_y );
-	unsigned int	nchars = ( max_y - min_y + 1 ) * ( max_x - min_x + 1 );
+	__c_fill( SHADOW_ADDR( min_x, min_y ),
+		  ( max_y - min_y + 1 ) * ( max_x - min_x + 1 ) );
+	dirty = ALL_ROWS;
+}
+
 
-	while( nchars > 0 ){
-		*to++ = ' ' | 0x0700;
-		nchars -= 1;
+/*
+** Scroll a full-width region on the screen by moving the origin down
+** 'lines' rows, so the rows which stay on the screen aren't moved at
+** all.  The rows outside the region must stay where they are on the screen,
+** so they are copied to the new origin; the rows below the region
+** are done first, bottom up, and then the rows above it, bottom up,
+** so that nothing is overwritten before it has been copied.
+**
+** When the screen would run off the end of the text memory, it is
+** copied back to the start.
+*/
+static void __c_scroll_origin( unsigned int lines ){
+	unsigned int	from = origin;
+	unsigned int	to = origin + lines * SCREEN_X_SIZE;
+	unsigned int	rows = scroll_max_y - scroll_min_y + 1 - lines;
+	unsigned int	y;
+
+	if( to + SCREEN_X_SIZE * SCREEN_Y_SIZE > VIDEO_CELLS ){
+		to = 0;
+		__c_copy( CELL_ADDR( to, 0, scroll_min_y ),
+			  CELL_ADDR( from, 0, scroll_min_y + lines ),
+			  rows * SCREEN_X_SIZE );
+	}
+
+	for( y = max_y; y > scroll_max_y; y -= 1 ){
+		__c_copy( CELL_ADDR( to, 0, y ), CELL_ADDR( from, 0, y ),
+			  SCREEN_X_SIZE );
 	}
-}
 
+	__c_fill( CELL_ADDR( to, 0, scroll_min_y + rows ),
+		  lines * SCREEN_X_SIZE );
 
+	for( y = scroll_min_y; y > min_y; y -= 1 ){
+		__c_copy( CELL_ADDR( to, 0, y - 1 ), CELL_ADDR( from, 0, y - 1 ),
+			  SCREEN_X_SIZE );
+	}
+
+	origin = to;
+	__c_setorigin();
+}
+
+/*
+** Scroll the scroll region up by 'lines' rows.
+**
+** The shadow is scrolled by copying the surviving rows up as one
+** block (full width) or a row at a time.  A full-width region is
+** scrolled on the screen by moving the origin when the shadow is
+** next flushed, unless more rows lie outside the region (and would
+** have to be copied) than in it, or the system is built with
+** CONSOLE_SOFT_SCROLL defined; then, the whole region is redrawn.
+*/
 void c_scroll( unsigned int lines ){
-	unsigned short *from;
-	unsigned short *to;
-	int	nchars = scroll_max_x - scroll_min_x + 1;
-	int	line, c;
+	unsigned int	nchars = scroll_max_x - scroll_min_x + 1;
+	unsigned int	region = ROWS( scroll_min_y, scroll_max_y );
+	unsigned int	rows, y;
 
 	/*
 	** If # of lines is the whole scrolling region or more, just clear.
@@ -275,248 +493,556 @@ void c_scroll( unsigned int lines ){
 		return;
 	}
 
-	/*
-	** Must copy it line by line.
-	*/
-	for( line = scroll_min_y; (unsigned)line <= scroll_max_y - lines; line += 1 ){
-		from = VIDEO_ADDR( scroll_min_x, line + lines );
-		to = VIDEO_ADDR( scroll_min_x, line );
-		for( c = 0; c < nchars; c += 1 ){
-			*to++ = *from++;
-		}
+	if( lines == 0 ){
+		return;
 	}
 
-	for( ; (unsigned)line <= scroll_max_y; line += 1 ){
-		to = VIDEO_ADDR( scroll_min_x, line );
-		for( c = 0; c < nchars; c += 1 ){
-			*to++ = ' ' | 0x0700;
+	rows = scroll_max_y - scroll_min_y + 1 - lines;
+
+	if( nchars == SCREEN_X_SIZE ){
+		__c_copy( SHADOW_ADDR( 0, scroll_min_y ),
+			  SHADOW_ADDR( 0, scroll_min_y + lines ),
+			  rows * SCREEN_X_SIZE );
+	}
+	else {
+		for( y = scroll_min_y; y < scroll_min_y + rows; y += 1 ){
+			__c_copy( SHADOW_ADDR( scroll_min_x, y ),
+				  SHADOW_ADDR( scroll_min_x, y + lines ), nchars );
 		}
 	}
-}
 
-char * cvtdec0( char *buf, int value ){
-	int	quotient;
-
-	quotient = value / 10;
-	if( quotient < 0 ){
-		quotient = 214748364;
-		value = 8;
+	for( y = scroll_min_y + rows; y <= scroll_max_y; y += 1 ){
+		__c_fill( SHADOW_ADDR( scroll_min_x, y ), nchars );
 	}
-	if( quotient != 0 ){
-		buf = cvtdec0( buf, quotient );
+
+#ifndef CONSOLE_SOFT_SCROLL
+	if( current == shown && nchars == SCREEN_X_SIZE &&
+	    ( scroll_min_y - min_y ) + ( max_y - scroll_max_y ) < rows &&
+	    pending + lines <= scroll_max_y - scroll_min_y ){
+		/*
+		** The screen will be scrolled too, so the rows which
+		** differ from it move up with their contents
+		*/
+		pending += lines;
+		dirty = ( dirty & ~region ) | ( ( dirty & region ) >> lines ) |
+			ROWS( scroll_min_y + rows, scroll_max_y );
+		return;
 	}
-	*buf++ = value % 10 + '0';
-	return buf;
+#endif
+
+	dirty |= region;
 }
 
-int cvtdec( char *buf, int value ){
-	char	*bp = buf;
+/*
+** Bring the screen up to date with the shadow: apply any pending
+** origin scroll, copy the dirty rows, and move the hardware cursor.
+** Done with interrupts off, so output from an ISR can't come in
+** between clearing a row's dirty bit and copying it.
+*/
+void c_flush( void ){
+	__c_console_t	*was;
+	int		interrupts_enabled;
+	unsigned int	y;
 
-	if( value < 0 ){
-		*bp++ = '-';
-		value = -value;
+	if( headless || ( dirty == 0 && pending == 0 && !cursor_moved &&
+			  focus == shown && current == shown ) ){
+		return;
 	}
-	bp = cvtdec0( bp, value );
-	*bp = '\0';
 
-	return bp - buf;
-}
+	interrupts_enabled = __get_flags() & EFLAGS_IF;
+	__asm__ __volatile__( "cli" );
 
-char hexdigits[] = "0123456789ABCDEF";
+	was = current;
+	__c_select( shown );
 
-int cvthex( char *buf, int value ){
-	int	i;
-	int	chars_stored = 0;
-	char	*bp = buf;
+	if( focus != shown ){
+		/*
+		** Show another console; the screen is wholly out of date
+		*/
+		shown = focus;
+		pending = 0;
+		__c_select( shown );
+		dirty = ALL_ROWS;
+		cursor_moved = 1;
+	}
 
-	for( i = 0; i < 8; i += 1 ){
-		int	val;
+	if( pending ){
+		__c_scroll_origin( pending );
+		pending = 0;
+	}
 
-		val = ( value & 0xf0000000 );
-		if( i == 7 || val != 0 || chars_stored ){
-			chars_stored = 1;
-			val >>= 28;
-			val &= 0xf;
-			*bp++ = hexdigits[ val ];
+	for( y = min_y; dirty != 0 && y <= max_y; y += 1 ){
+		if( dirty & ( 1u << y ) ){
+			__c_copy( CELL_ADDR( origin, 0, y ), SHADOW_ADDR( 0, y ),
+				  SCREEN_X_SIZE );
+			dirty &= ~( 1u << y );
 		}
-		value <<= 4;
 	}
-	*bp = '\0';
 
-	return bp - buf;
-}
-
-int cvtoct( char *buf, int value ){
-	int	i;
-	int	chars_stored = 0;
-	char	*bp = buf;
-	int	val;
+	if( cursor_moved ){
+		cursor_moved = 0;
+		__c_showcursor();
+	}
 
-	val = ( value & 0xc0000000 );
-	val >>= 30;
-	for( i = 0; i < 11; i += 1 ){
+	__c_select( was );
 
-		if( i == 10 || val != 0 || chars_stored ){
-			chars_stored = 1;
-			val &= 0x7;
-			*bp++ = hexdigits[ val ];
-		}
-		value <<= 3;
-		val = ( value & 0xe0000000 );
-		val >>= 29;
+	if( interrupts_enabled ){
+		__asm__ __volatile__( "sti" );
 	}
-	*bp = '\0';
+}
+
+int c_flush_needed( void ){
+	unsigned int	shown_dirty = current == shown ? dirty : shown->dirty;
 
-	return bp - buf;
+	return !headless && ( shown_dirty != 0 || pending != 0 ||
+			      cursor_moved || focus != shown );
 }
 
-static int pad( int x, int y, int extra, int padchar ){
-	while( extra > 0 ){
-		if( x != -1 || y != -1 ){
-			c_putchar_at( x, y, padchar );
-			x += 1;
+int c_headless( int on ){
+	int	was = headless;
+
+	headless = on != 0;
+	if( was && !headless ){
+		/*
+		** The screen is wholly out of date
+		*/
+		pending = 0;
+		if( current == shown ){
+			dirty = ALL_ROWS;
 		}
 		else {
-			c_putchar( padchar );
+			shown->dirty = ALL_ROWS;
 		}
-		extra -= 1;
+		cursor_moved = 1;
 	}
-	return x;
+	return was;
 }
 
-static int padstr( int x, int y, char *str, int len, int width, int leftadjust, int padchar ){
-	int	extra;
+/*
+** Virtual consoles.  The c_vc_ routines do their work on another
+** console by making it current for the duration.
+*/
+void c_vc_show( unsigned int vc ){
+	if( vc < C_CONSOLES ){
+		focus = &consoles[ vc ];
+	}
+}
+
+int c_vc_shown( void ){
+	return focus - consoles;
+}
+
+void c_vc_putbuf( unsigned int vc, char *str, int num ){
+	__c_console_t	*was = current;
+
+	if( vc < C_CONSOLES ){
+		__c_select( &consoles[ vc ] );
+		c_putbuf( str, num );
+		__c_select( was );
+	}
+}
+
+int c_vc_getbuf( unsigned int vc, char *buffer, unsigned int size ){
+	__c_console_t	*was = current;
+	int	count = 0;
+
+	if( vc < C_CONSOLES ){
+		__c_select( &consoles[ vc ] );
+		count = c_getbuf( buffer, size );
+		__c_select( was );
+	}
+	return count;
+}
+
+int c_vc_input_queue( unsigned int vc ){
+	__c_console_t	*was = current;
+	int	count = 0;
 
-	if( len < 0 ){
-		len = __c_strlen( str );
+	if( vc < C_CONSOLES ){
+		__c_select( &consoles[ vc ] );
+		count = c_input_queue();
+		__c_select( was );
 	}
-	extra = width - len;
-	if( extra > 0 && !leftadjust ){
-		x = pad( x, y, extra, padchar );
+	return count;
+}
+
+/*
+** Formatted output.
+**
+** __c_format does all the work for c_printf, c_printf_at and
+** c_snprintf (and the user library's printf).  It keeps no state of
+** its own, so it may be used by any number of callers at once; the
+** characters go into a buffer supplied by the caller, and when that
+** fills up, it is handed to the caller's flush routine (if any) and
+** reused.  The console routines thus see one c_putbuf per call
+** rather than one call per character.
+**
+** Numbers are converted right to left into a small buffer; decimal
+** numbers two digits per division, using a table of digit pairs.
+** Values which don't fit in 32 bits are first divided down by 10000
+** using only 32-bit divisions, since the kernel has no 64-bit
+** division routines.
+*/
+typedef struct __c_fmt {
+	char	*buf;		/* where characters go */
+	unsigned int	size;	/* room in buf */
+	unsigned int	len;	/* characters in buf */
+	int	total;		/* characters produced in all */
+	void	( *flush )( struct __c_fmt * );	/* empties buf; or NULL */
+	int	x, y;		/* for c_printf_at */
+} __c_fmt_t;
+
+static const char __c_hexdigits[] = "0123456789ABCDEF";
+
+static const char __c_decpairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/*
+** Longest conversion: a 64-bit value in octal
+*/
+#define	CVT_SIZE	22
+
+static char * __c_cvtdec32( char *end, unsigned int value ){
+	unsigned int	pair;
+
+	while( value >= 100 ){
+		pair = ( value % 100 ) * 2;
+		value /= 100;
+		*--end = __c_decpairs[ pair + 1 ];
+		*--end = __c_decpairs[ pair ];
 	}
-	if( x != -1 || y != -1 ){
-		c_puts_at( x, y, str );
-		x += len;
+	if( value >= 10 ){
+		*--end = __c_decpairs[ value * 2 + 1 ];
+		*--end = __c_decpairs[ value * 2 ];
 	}
 	else {
-		c_puts( str );
+		*--end = '0' + value;
+	}
+	return end;
+}
+
+static char * __c_cvtdec( char *end, unsigned long long value ){
+	unsigned int	hi = (unsigned int) ( value >> 32 );
+	unsigned int	lo = (unsigned int) value;
+	unsigned int	rem, t, q1, q0;
+
+	while( hi != 0 ){
+		/*
+		** Divide hi:lo by 10000 sixteen bits at a time; each
+		** partial dividend is less than 10000 * 65536
+		*/
+		rem = hi % 10000;
+		hi /= 10000;
+		t = ( rem << 16 ) | ( lo >> 16 );
+		q1 = t / 10000;
+		rem = t % 10000;
+		t = ( rem << 16 ) | ( lo & 0xffff );
+		q0 = t / 10000;
+		rem = t % 10000;
+		lo = ( q1 << 16 ) | q0;
+
+		*--end = __c_decpairs[ ( rem % 100 ) * 2 + 1 ];
+		*--end = __c_decpairs[ ( rem % 100 ) * 2 ];
+		*--end = __c_decpairs[ ( rem / 100 ) * 2 + 1 ];
+		*--end = __c_decpairs[ ( rem / 100 ) * 2 ];
+		if( hi == 0 && lo == 0 ){
+			return end;
+		}
 	}
-	if( extra > 0 && leftadjust ){
-		x = pad( x, y, extra, padchar );
+	return __c_cvtdec32( end, lo );
+}
+
+static char * __c_cvtbase( char *end, unsigned long long value, int shift ){
+	unsigned int	mask = ( 1u << shift ) - 1;
+
+	do {
+		*--end = __c_hexdigits[ (unsigned int) value & mask ];
+		value >>= shift;
+	} while( value != 0 );
+	return end;
+}
+
+static void __c_fmtput( __c_fmt_t *out, int ch ){
+	if( out->len + 1 >= out->size && out->flush != 0 ){
+		out->flush( out );
+		out->len = 0;
+	}
+	/*
+	** Always leave room for the terminating null byte
+	*/
+	if( out->len + 1 < out->size ){
+		out->buf[ out->len++ ] = ch;
+	}
+	out->total += 1;
+}
+
+static void __c_fmtpad( __c_fmt_t *out, int ch, int count ){
+	while( count-- > 0 ){
+		__c_fmtput( out, ch );
 	}
-	return x;
 }
 
-static void __c_do_printf( int x, int y, char **f ){
-	char	*fmt = *f;
-	int	*ap;
-	char	buf[ 12 ];
+static void __c_format( __c_fmt_t *out, char *fmt, unsigned int *ap ){
+	char	buf[ CVT_SIZE ];
+	char	*end = buf + CVT_SIZE;
 	char	ch;
 	char	*str;
+	char	*sign;
+	unsigned long long	value;
 	int	leftadjust;
+	int	padchar;
 	int	width;
+	int	precision;
+	int	longs;
 	int	len;
-	int	padchar;
+	int	zeros;
 
 	/*
 	** Get characters from the format string and process them
 	*/
-	ap = (int *)( f + 1 );
 	while( (ch = *fmt++) != '\0' ){
+		if( ch != '%' ){
+			__c_fmtput( out, ch );
+			continue;
+		}
+
 		/*
-		** Is it the start of a format code?
+		** Get the padding, width, precision and size options (if
+		** there).  Alignment must come at the beginning, then
+		** fill, then width, then precision, then size.
 		*/
-		if( ch == '%' ){
-			/*
-			** Yes, get the padding and width options (if there).
-			** Alignment must come at the beginning, then fill,
-			** then width.
-			*/
-			leftadjust = 0;
-			padchar = ' ';
-			width = 0;
+		leftadjust = 0;
+		padchar = ' ';
+		width = 0;
+		precision = -1;
+		longs = 0;
+		ch = *fmt++;
+		if( ch == '-' ){
+			leftadjust = 1;
 			ch = *fmt++;
-			if( ch == '-' ){
-				leftadjust = 1;
+		}
+		if( ch == '0' ){
+			padchar = '0';
+			ch = *fmt++;
+		}
+		while( ch >= '0' && ch <= '9' ){
+			width = width * 10 + ch - '0';
+			ch = *fmt++;
+		}
+		if( ch == '.' ){
+			precision = 0;
+			ch = *fmt++;
+			while( ch >= '0' && ch <= '9' ){
+				precision = precision * 10 + ch - '0';
 				ch = *fmt++;
 			}
-			if( ch == '0' ){
-				padchar = '0';
-				ch = *fmt++;
+		}
+		while( ch == 'l' ){
+			longs += 1;
+			ch = *fmt++;
+		}
+
+		sign = "";
+		zeros = 0;
+
+		/*
+		** What data type do we have?
+		*/
+		switch( ch ){
+		case 'c':
+			buf[ 0 ] = *ap++;
+			str = buf;
+			len = 1;
+			break;
+
+		case 's':
+			str = (char *) (unsigned long) *ap++;
+			if( str == 0 ){
+				str = "(null)";
 			}
-			while( ch >= '0' && ch <= '9' ){
-				width *= 10;
-				width += ch - '0';
-				ch = *fmt++;
+			for( len = 0; str[ len ] != '\0'; len += 1 ){
+				if( len == precision ){
+					break;
+				}
 			}
+			break;
 
+		case 'd':
+		case 'u':
+		case 'x':
+		case 'o':
 			/*
-			** What data type do we have?
+			** "long long" takes two argument words, low first;
+			** "long" is the same size as "int"
 			*/
-			switch( ch ){
-			case 'c':
-				// ch = *( (int *)ap )++;
-				ch = *ap++;
-				buf[ 0 ] = ch;
-				buf[ 1 ] = '\0';
-				x = padstr( x, y, buf, 1, width, leftadjust, padchar );
-				break;
-
-			case 'd':
-				// len = cvtdec( buf, *( (int *)ap )++ );
-				len = cvtdec( buf, *ap++ );
-				x = padstr( x, y, buf, len, width, leftadjust, padchar );
-				break;
-
-			case 's':
-				// str = *( (char **)ap )++;
-				str = (char *) (unsigned long) (*ap++);
-				x = padstr( x, y, str, -1, width, leftadjust, padchar );
-				break;
-
-			case 'x':
-				// len = cvthex( buf, *( (int *)ap )++ );
-				len = cvthex( buf, *ap++ );
-				x = padstr( x, y, buf, len, width, leftadjust, padchar );
-				break;
-
-			case 'o':
-				// len = cvtoct( buf, *( (int *)ap )++ );
-				len = cvtoct( buf, *ap++ );
-				x = padstr( x, y, buf, len, width, leftadjust, padchar );
-				break;
+			if( longs >= 2 ){
+				value = ap[ 0 ] | ( (unsigned long long) ap[ 1 ] << 32 );
+				ap += 2;
+				if( ch == 'd' && (long long) value < 0 ){
+					sign = "-";
+					value = -value;
+				}
+			}
+			else {
+				value = *ap++;
+				if( ch == 'd' && (int) value < 0 ){
+					sign = "-";
+					value = -(unsigned int) value;
+				}
+			}
 
+			if( ch == 'x' ){
+				str = __c_cvtbase( end, value, 4 );
 			}
-		}
-		else {
-			if( x != -1 || y != -1 ){
-				c_putchar_at( x, y, ch );
-				switch( ch ){
-				case '\n':
-					y += 1;
-					/* FALL THRU */
-
-				case '\r':
-					x = scroll_min_x;
-					break;
+			else if( ch == 'o' ){
+				str = __c_cvtbase( end, value, 3 );
+			}
+			else {
+				str = __c_cvtdec( end, value );
+			}
+			len = end - str;
 
-				default:
-					x += 1;
+			/*
+			** A precision is the minimum number of digits, and
+			** overrides zero-fill
+			*/
+			if( precision >= 0 ){
+				padchar = ' ';
+				if( precision == 0 && value == 0 ){
+					len = 0;
+				}
+				if( precision > len ){
+					zeros = precision - len;
 				}
 			}
-			else {
-				c_putchar( ch );
+			else if( padchar == '0' && !leftadjust ){
+				zeros = width - len - ( *sign != '\0' );
 			}
+			break;
+
+		case '\0':
+			/*
+			** Format ends in the middle of a conversion
+			*/
+			fmt -= 1;
+			continue;
+
+		default:
+			/*
+			** "%%", and anything we don't understand
+			*/
+			__c_fmtput( out, ch );
+			continue;
+		}
+
+		if( ( ch == 'c' || ch == 's' ) && padchar == '0' && !leftadjust ){
+			zeros = width - len;
+		}
+
+		width -= len + zeros + ( *sign != '\0' );
+		if( !leftadjust ){
+			__c_fmtpad( out, ' ', width );
+		}
+		while( *sign != '\0' ){
+			__c_fmtput( out, *sign++ );
+		}
+		__c_fmtpad( out, '0', zeros );
+		while( len-- > 0 ){
+			__c_fmtput( out, *str++ );
+		}
+		if( leftadjust ){
+			__c_fmtpad( out, ' ', width );
+		}
+	}
+
+	if( out->size > 0 ){
+		out->buf[ out->len ] = '\0';
+	}
+}
+
+int c_vsnprintf( char *buf, unsigned int size, char *fmt, void *args ){
+	__c_fmt_t	out;
+
+	out.buf = buf;
+	out.size = size;
+	out.len = 0;
+	out.total = 0;
+	out.flush = 0;
+	__c_format( &out, fmt, (unsigned int *) args );
+	return out.total;
+}
+
+int c_snprintf( char *buf, unsigned int size, char *fmt, ... ){
+	return c_vsnprintf( buf, size, fmt, &fmt + 1 );
+}
+
+/*
+** Size of the buffers used by c_printf and c_printf_at; longer
+** output is written in pieces
+*/
+#define	PRINTF_BUFSIZE	256
+
+static void __c_printf_flush( __c_fmt_t *out ){
+	c_putbuf( out->buf, out->len );
+}
+
+static void __c_printf_at_flush( __c_fmt_t *out ){
+	unsigned int	i;
+	char	ch;
+
+	for( i = 0; i < out->len; i += 1 ){
+		ch = out->buf[ i ];
+		c_putchar_at( out->x, out->y, ch );
+		switch( ch ){
+		case '\n':
+			out->y += 1;
+			/* FALL THRU */
+
+		case '\r':
+			out->x = scroll_min_x;
+			break;
+
+		default:
+			out->x += 1;
 		}
 	}
 }
 
 void c_printf_at( unsigned int x, unsigned int y, char *fmt, ... ){
-	__c_do_printf( x, y, &fmt );
+	char	buf[ PRINTF_BUFSIZE ];
+	__c_fmt_t	out;
+
+	out.buf = buf;
+	out.size = sizeof( buf );
+	out.len = 0;
+	out.total = 0;
+	out.flush = __c_printf_at_flush;
+	out.x = x;
+	out.y = y;
+	__c_format( &out, fmt, (unsigned int *) ( &fmt + 1 ) );
+	__c_printf_at_flush( &out );
 }
 
 void c_printf( char *fmt, ... ){
-	__c_do_printf( -1, -1, &fmt );
+	char	buf[ PRINTF_BUFSIZE ];
+	__c_fmt_t	out;
+
+	out.buf = buf;
+	out.size = sizeof( buf );
+	out.len = 0;
+	out.total = 0;
+	out.flush = __c_printf_flush;
+	__c_format( &out, fmt, (unsigned int *) ( &fmt + 1 ) );
+	__c_printf_flush( &out );
 }
 
 unsigned char scan_code[ 2 ][ 128 ] = {
@@ -559,24 +1085,18 @@ unsigned char scan_code[ 2 ][ 128 ] = {
 	}
 };
 
-#define	C_BUFSIZE	200
 #define	KEYBOARD_DATA	0x60
 #define	KEYBOARD_STATUS	0x64
 #define	READY		0x1
 #define	EOT		'\04'
 
-/*
-** Circular buffer for input characters.  Characters are inserted at
-** __c_next_space, and are removed at __c_next_char.  Buffer is empty if
-** these are equal.
-*/
-static	char	__c_input_buffer[ C_BUFSIZE ];
-static	volatile char	*__c_next_char = __c_input_buffer;
-static	volatile char	*__c_next_space = __c_input_buffer;
+#define	ALT_PRESS	0x38
+#define	ALT_RELEASE	0xb8
+#define	F1		0x3b
 
-static	volatile char *__c_increment( volatile char *pointer ){
-	if( ++pointer >= __c_input_buffer + C_BUFSIZE ){
-		pointer = __c_input_buffer;
+static	volatile char *__c_increment( __c_console_t *vc, volatile char *pointer ){
+	if( ++pointer >= vc->input + C_BUFSIZE ){
+		pointer = vc->input;
 	}
 	return pointer;
 }
@@ -584,6 +1104,7 @@ static	volatile char *__c_increment( volatile char *pointer ){
 static void __c_input_scan_code( int code ){
 	static	int	shift = 0;
 	static	int	ctrl_mask = 0xff;
+	static	int	alt = 0;
 
 	/*
 	** Do the shift processing
@@ -608,23 +1129,35 @@ static void __c_input_scan_code( int code ){
 		ctrl_mask = 0xff;
 		break;
 
+	case ALT_PRESS:
+		alt = 1;
+		break;
+
+	case ALT_RELEASE:
+		alt = 0;
+		break;
+
 	default:
 		/*
 		** Process ordinary characters only on the press
 		** (to handle autorepeat).
 		** Ignore undefined scan codes.
 		*/
-		if( ( code & 0x80 ) == 0 ){
+		if( alt && code >= F1 && code < F1 + C_CONSOLES ){
+			c_vc_show( code - F1 );
+		}
+		else if( ( code & 0x80 ) == 0 ){
 			code = scan_code[ shift ][ (int)code ];
 			if( code != '\377' ){
-				volatile char	*next = __c_increment( __c_next_space );
+				__c_console_t	*vc = focus;
+				volatile char	*next = __c_increment( vc, vc->next_space );
 
 				/*
 				** Store character only if there's room
 				*/
-				if( next != __c_next_char ){
-					*__c_next_space = code & ctrl_mask;
-					__c_next_space = next;
+				if( next != vc->next_char ){
+					*vc->next_space = code & ctrl_mask;
+					vc->next_space = next;
 				}
 			}
 		}
@@ -642,11 +1175,13 @@ int c_getchar( void ){
 	char	c;
 	int	interrupts_enabled = __get_flags() & EFLAGS_IF;
 
-	while( __c_next_char == __c_next_space ){
+	while( current->next_char == current->next_space ){
 		if( !interrupts_enabled ){
 			/*
-			** Must read the next keystroke ourselves.
+			** Must read the next keystroke ourselves (and
+			** show the screen, as nothing else will).
 			*/
+			c_flush();
 			while( ( __inb( KEYBOARD_STATUS ) & READY ) == 0 ){
 				;
 			}
@@ -654,10 +1189,13 @@ int c_getchar( void ){
 		}
 	}
 
-	c = *__c_next_char & 0xff;
-	__c_next_char = __c_increment( __c_next_char );
+	c = *current->next_char & 0xff;
+	current->next_char = __c_increment( current, current->next_char );
 	if( c != EOT ){
 		c_putchar( c );
+		if( !interrupts_enabled ){
+			c_flush();
+		}
 	}
 	return c;
 }
@@ -683,7 +1221,7 @@ int c_gets( char *buffer, unsigned int size ){
 }
 
 int c_input_queue( void ){
-	int	n_chars = __c_next_space - __c_next_char;
+	int	n_chars = current->next_space - current->next_char;
 
 	if( n_chars < 0 ){
 		n_chars += C_BUFSIZE;
@@ -691,10 +1229,37 @@ int c_input_queue( void ){
 	return n_chars;
 }
 
+int c_getbuf( char *buffer, unsigned int size ){
+	char	*start = buffer;
+	int	count = 0;
+
+	while( size > 0 && current->next_char != current->next_space ){
+		*buffer++ = *current->next_char & 0xff;
+		current->next_char = __c_increment( current, current->next_char );
+		count += 1;
+		size -= 1;
+	}
+
+	/*
+	** Echo everything but EOTs, a run at a time
+	*/
+	for( buffer = start; buffer < start + count; ++buffer ){
+		if( *buffer == EOT ){
+			c_putbuf( start, buffer - start );
+			start = buffer + 1;
+		}
+	}
+	c_putbuf( start, buffer - start );
+
+	return count;
+}
+
 /*
 ** Initialization routines
 */
 void c_io_init( void ){
+	__c_console_t	*vc;
+
 	/*
 	** Screen dimensions
 	*/
@@ -704,16 +1269,38 @@ void c_io_init( void ){
 	max_y  = SCREEN_MAX_Y;
 
 	/*
-	** Scrolling region
+	** The consoles start out blank, with the whole screen as the
+	** scrolling region and the cursor at its top left
 	*/
+	for( vc = consoles; vc < consoles + C_CONSOLES; vc += 1 ){
+		__c_fill( vc->cells, SCREEN_X_SIZE * SCREEN_Y_SIZE );
+		vc->dirty = 0;
+		vc->scroll_min_x = SCREEN_MIN_X;
+		vc->scroll_min_y = SCREEN_MIN_Y;
+		vc->scroll_max_x = SCREEN_MAX_X;
+		vc->scroll_max_y = SCREEN_MAX_Y;
+		vc->curr_x = SCREEN_MIN_X;
+		vc->curr_y = SCREEN_MIN_Y;
+		vc->next_char = vc->next_space = vc->input;
+	}
+	current = shown = focus = &consoles[ 0 ];
+	shadow = current->cells;
 	scroll_min_x = SCREEN_MIN_X;
 	scroll_min_y = SCREEN_MIN_Y;
 	scroll_max_x = SCREEN_MAX_X;
 	scroll_max_y = SCREEN_MAX_Y;
 
 	/*
-	** Initial cursor location
+	** Display from the start of the text memory, starting console
+	** 0 with what is already on the screen, and set the initial
+	** cursor location
 	*/
+	origin = 0;
+	__c_setorigin();
+	__c_copy( SHADOW_ADDR( 0, 0 ), CELL_ADDR( 0, 0, 0 ),
+		  SCREEN_X_SIZE * SCREEN_Y_SIZE );
+	dirty = 0;
+	pending = 0;
 	curr_y = min_y;
 	curr_x = min_x;
 	__c_setcursor();
@@ -749,6 +1336,13 @@ int main(){
 	c_printf( "|%04x|\n", 20 );
 	c_printf( "|%012x|\n", 0xfedcba98 );
 	c_printf( "|%-012x|\n", 0x76543210 );
+	c_printf( "%u\n", 0x80000000 );
+	c_printf( "%lu\n", 0xffffffff );
+	c_printf( "%llu\n", 0xffffffffffffffffULL );
+	c_printf( "%lld\n", -1234567890123LL );
+	c_printf( "%llx\n", 0x123456789abcdefULL );
+	c_printf( "|%8.5d|\n", -42 );
+	c_printf( "|%.3s|\n", "abcdef" );
 }
 
 int curr_x, curr_y, max_x, max_y;
@@ -1,23 +1,315 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	c_string.c
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	String library implementations
+**
+** Once a pointer is longword-aligned, the scanning routines test four
+** characters at a time:  HAS_ZERO(w) is nonzero exactly when some
+** byte of 'w' is zero, so a longword of string with no terminator
+** (or, after an XOR with a repeated pattern, no match) costs a few
+** instructions instead of four compares and branches.  An aligned
+** longword never crosses a page, so reading the bytes after the
+** terminator is harmless.
+**
+** Compile with -DSA_DEBUG to build a host program which checks these
+** against the C library.
+*/
+
 #include "c_string.h"
 
-int c_strcmp(char *a, char *b){
-    for (int i = 0; a != '\0' && b != '\0'; i++){
-        if (a[i] != b[i]){
-            return a - b;
-        }
-    }
-    if (a == '\0' && b == '\0') {
-        return 0;
-    } else if (a == '\0') {
-        return 0-(int)b;
-    }
-    return (int)a;
-}
-
-unsigned int c_strlen(char *a){
-    char *b = a;
-    while(b){
-        b++;
-    }
-    return (unsigned int)(b-a);
+/*
+** PRIVATE DEFINITIONS
+*/
+
+#ifndef NULL
+#define	NULL		0
+#endif
+
+#define	ONES		0x01010101U
+#define	HIGHS		0x80808080U
+
+#define	HAS_ZERO(w)	( ((w) - ONES) & ~(w) & HIGHS )
+
+#define	ALIGNED(p)	( ((unsigned long) (p) & 3) == 0 )
+
+/*
+** PRIVATE DATA TYPES
+*/
+
+// a longword which may alias the characters it is read from
+
+typedef unsigned int __attribute__((__may_alias__)) word_t;
+
+/*
+** PUBLIC FUNCTIONS
+*/
+
+/*
+** c_strlen(s)
+**
+** returns the length of 's'
+*/
+
+unsigned int c_strlen( char *s ) {
+	char *p = s;
+	word_t *w;
+
+	for( ; !ALIGNED(p); ++p ) {
+		if( *p == '\0' ) {
+			return( p - s );
+		}
+	}
+
+	for( w = (word_t *) p; !HAS_ZERO(*w); ++w ) {
+		continue;
+	}
+
+	for( p = (char *) w; *p != '\0'; ++p ) {
+		continue;
+	}
+
+	return( p - s );
+}
+
+/*
+** c_strnlen(s,max)
+**
+** returns the length of 's', or 'max' if that is smaller
+*/
+
+unsigned int c_strnlen( char *s, unsigned int max ) {
+	char *p = s;
+	char *end = s + max;
+
+	for( ; p < end && !ALIGNED(p); ++p ) {
+		if( *p == '\0' ) {
+			return( p - s );
+		}
+	}
+
+	while( end - p >= 4 && !HAS_ZERO(*(word_t *) p) ) {
+		p += 4;
+	}
+
+	for( ; p < end; ++p ) {
+		if( *p == '\0' ) {
+			break;
+		}
+	}
+
+	return( p - s );
+}
+
+/*
+** c_strncmp(a,b,n)
+**
+** compare at most 'n' characters of two strings
+**
+** returns <0, 0 or >0 as 'a' is less than, equal to or greater than 'b'
+*/
+
+int c_strncmp( char *a, char *b, unsigned int n ) {
+	unsigned char *x = (unsigned char *) a;
+	unsigned char *y = (unsigned char *) b;
+
+	// longwords at a time only works if both strings line up
+
+	if( ((unsigned long) x & 3) == ((unsigned long) y & 3) ) {
+		for( ; n > 0 && !ALIGNED(x); --n, ++x, ++y ) {
+			if( *x != *y || *x == '\0' ) {
+				return( *x - *y );
+			}
+		}
+		while( n >= 4 ) {
+			word_t wx = *(word_t *) x;
+			if( wx != *(word_t *) y || HAS_ZERO(wx) ) {
+				break;
+			}
+			x += 4;
+			y += 4;
+			n -= 4;
+		}
+	}
+
+	for( ; n > 0; --n, ++x, ++y ) {
+		if( *x != *y || *x == '\0' ) {
+			return( *x - *y );
+		}
+	}
+
+	return( 0 );
+}
+
+/*
+** c_strcmp(a,b)
+**
+** compare two strings
+**
+** returns <0, 0 or >0 as 'a' is less than, equal to or greater than 'b'
+*/
+
+int c_strcmp( char *a, char *b ) {
+
+	return( c_strncmp(a,b,~0U) );
+}
+
+/*
+** c_memchr(buf,c,len)
+**
+** returns a pointer to the first 'c' in 'len' bytes of 'buf', or NULL
+*/
+
+void *c_memchr( void *buf, int c, unsigned int len ) {
+	unsigned char *p = buf;
+	unsigned char *end = p + len;
+	unsigned int pat = (c & 0xff) * ONES;
+
+	for( ; p < end && !ALIGNED(p); ++p ) {
+		if( *p == (c & 0xff) ) {
+			return( p );
+		}
+	}
+
+	while( end - p >= 4 ) {
+		word_t w = *(word_t *) p ^ pat;
+		if( HAS_ZERO(w) ) {
+			break;
+		}
+		p += 4;
+	}
+
+	for( ; p < end; ++p ) {
+		if( *p == (c & 0xff) ) {
+			return( p );
+		}
+	}
+
+	return( NULL );
+}
+
+/*
+** c_strchr(s,c)
+**
+** returns a pointer to the first 'c' in 's' (or to its terminator,
+** if 'c' is '\0'), or NULL
+*/
+
+char *c_strchr( char *s, int c ) {
+	char ch = c;
+	unsigned int pat = (c & 0xff) * ONES;
+	word_t *w;
+
+	for( ; !ALIGNED(s); ++s ) {
+		if( *s == ch ) {
+			return( s );
+		}
+		if( *s == '\0' ) {
+			return( NULL );
+		}
+	}
+
+	for( w = (word_t *) s; !HAS_ZERO(*w) && !HAS_ZERO(*w ^ pat); ++w ) {
+		continue;
+	}
+
+	for( s = (char *) w; *s != ch; ++s ) {
+		if( *s == '\0' ) {
+			return( NULL );
+		}
+	}
+
+	return( s );
+}
+
+/*
+** c_strstr(s,sub)
+**
+** returns a pointer to the first 'sub' in 's', or NULL
+*/
+
+char *c_strstr( char *s, char *sub ) {
+	unsigned int len = c_strlen( sub );
+
+	if( len == 0 ) {
+		return( s );
+	}
+
+	// only stop where the first character matches
+
+	while( (s = c_strchr(s,sub[0])) != NULL ) {
+		if( c_strncmp(s,sub,len) == 0 ) {
+			return( s );
+		}
+		++s;
+	}
+
+	return( NULL );
+}
+
+#ifdef SA_DEBUG
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int sign( int n ) {
+	return( n < 0 ? -1 : n > 0 );
+}
+
+int main( void ) {
+	static char a[ 300 ], b[ 300 ];
+	int bad = 0;
+
+	srand( 452 );
+	for( int i = 0; i < 200000; ++i ) {
+		int oa = rand() % 8, ob = rand() % 8;
+		int la = rand() % 80, lb = rand() % 80;
+		unsigned int n = rand() % 100;
+		char *x = a + oa, *y = b + ob, *sub;
+		int c = "abc\0\200"[ rand() % 5 ];
+
+		// small alphabets, so matches and common prefixes happen
+
+		for( int j = 0; j < la; ++j ) {
+			x[j] = "abc\200"[ rand() % 4 ];
+		}
+		x[la] = '\0';
+		if( rand() % 2 ) {
+			lb = la;
+			memcpy( y, x, la + 1 );
+			if( la > 0 && rand() % 2 ) {
+				y[ rand() % la ] ^= rand() % 2 ? 1 : 0x80;
+			}
+		} else {
+			for( int j = 0; j < lb; ++j ) {
+				y[j] = "abc\200"[ rand() % 4 ];
+			}
+			y[lb] = '\0';
+		}
+		sub = y + rand() % (lb + 1);
+		sub[ rand() % 5 ] = '\0';
+
+		if( c_strlen(x) != strlen(x) ||
+		    c_strnlen(x,n) != strnlen(x,n) ||
+		    sign(c_strcmp(x,y)) != sign(strcmp(x,y)) ||
+		    sign(c_strncmp(x,y,n)) != sign(strncmp(x,y,n)) ||
+		    c_memchr(x,c,n) != memchr(x,c,n) ||
+		    c_strchr(x,c) != strchr(x,c) ||
+		    c_strstr(x,sub) != strstr(x,sub) ) {
+			printf( "mismatch: \"%s\" \"%s\" \"%s\" %u %d\n",
+				x, y, sub, n, c );
+			if( ++bad > 10 ) {
+				break;
+			}
+		}
+	}
+
+	printf( "%s\n", bad ? "FAILED" : "passed" );
+	return( bad != 0 );
 }
+#endif
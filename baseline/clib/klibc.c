@@ -14,14 +14,31 @@
 
 #include "common.h"
 
+#include "klog.h"
+#include "process.h"
+#include "scheduler.h"
+#include "sio.h"
+
 /*
 ** PRIVATE DEFINITIONS
 */
 
+// longest traceback printed, and longest line of panic output
+
+#define	KPANIC_DEPTH	16
+#define	KPANIC_LINE	100
+
 /*
 ** PRIVATE DATA TYPES
 */
 
+// one entry in the kernel symbol table
+
+typedef struct ksym {
+	uint32_t	addr;
+	char		*name;
+} ksym_t;
+
 /*
 ** PRIVATE GLOBAL VARIABLES
 */
@@ -30,42 +47,104 @@
 ** PUBLIC GLOBAL VARIABLES
 */
 
+// the text symbols, in address order (made by KSyms at link time)
+
+extern ksym_t _ksyms[];
+extern uint32_t _ksym_count;
+
 /*
 ** PRIVATE FUNCTIONS
 */
 
 /*
-** PUBLIC FUNCTIONS
+** _kpanic_print(fmt,...)
+**
+** print a line of panic output on the console and the SIO
 */
 
+static void _kpanic_print( char *fmt, ... ) {
+	char line[ KPANIC_LINE ];
+
+	c_vsnprintf( line, sizeof(line), fmt, &fmt + 1 );
+	c_puts( line );
+	_sio_panic_puts( line );
+}
+
 /*
-** _put_char_or_code( ch )
+** _kpanic_addr(addr)
 **
-** prints the character on the console, unless it is a non-printing
-** character, in which case its hex code is printed
+** print a code address, and the function containing it
 */
 
-void _put_char_or_code( int ch ) {
+static void _kpanic_addr( uint32_t addr ) {
+	uint32_t lo = 0, hi = _ksym_count, mid;
 
-	if( ch >= ' ' && ch < 0x7f ) {
-		c_putchar( ch );
+	// find the last symbol at or below the address
+
+	while( lo < hi ) {
+		mid = (lo + hi) / 2;
+		if( _ksyms[mid].addr <= addr ) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if( lo == 0 ) {
+		_kpanic_print( "  %08x\n", addr );
 	} else {
-		c_printf( "\\x%02x", ch );
+		_kpanic_print( "  %08x  %s+0x%x\n", addr, _ksyms[lo - 1].name,
+			       addr - _ksyms[lo - 1].addr );
 	}
 }
 
 /*
-** _memset - initialize all bytes of a block of memory to a value
+** _kpanic_trace(fp)
+**
+** print the return addresses found by following the saved %ebp chain
+** from frame pointer 'fp'
 **
-** usage:  _memset( buffer, length, value )
+** Saved frame pointers must increase (stacks grow down), which stops
+** the walk at the outermost frame or at a clobbered one.
 */
 
-void _memset( register uint8_t *buf, register uint32_t len, uint8_t value ) {
-
-	while( len-- ) {
-		*buf++ = value;
+static void _kpanic_trace( uint32_t fp ) {
+	uint32_t *frame;
+
+	for( int i = 0; i < KPANIC_DEPTH; ++i ) {
+		if( fp == 0 || (fp & 3) != 0 ) {
+			break;
+		}
+		frame = (uint32_t *) fp;
+		if( frame[1] == 0 ) {
+			break;
+		}
+		_kpanic_addr( frame[1] );
+		if( frame[0] <= fp ) {
+			break;
+		}
+		fp = frame[0];
 	}
+}
+
+/*
+** PUBLIC FUNCTIONS
+*/
+
+/*
+** _put_char_or_code( ch )
+**
+** prints the character on the console, unless it is a non-printing
+** character, in which case its hex code is printed
+*/
+
+void _put_char_or_code( int ch ) {
 
+	if( ch >= ' ' && ch < 0x7f ) {
+		c_putchar( ch );
+	} else {
+		c_printf( "\\x%02x", ch );
+	}
 }
 
 /*
@@ -73,26 +152,67 @@ void _memset( register uint8_t *buf, register uint32_t len, uint8_t value ) {
 **
 ** usage:  _kpanic( module, msg );
 **
-** Prefix routine for __panic() - can be expanded to do other things
-** (e.g., printing a stack traceback)
+** Prefix routine for __panic():  prints the message, a traceback of
+** the calling code, and the current process' saved context and its
+** traceback, on both the console and the SIO
 **
 ** 'module' argument is always printed; 'msg' argument is printed
 ** if it isn't NULL, followed by a newline
 */
 
 void _kpanic( char *module, char *msg ) {
+	context_t *ctx;
+
+	__asm__ __volatile__( "cli" );
+
+	// show what led up to this
+
+	_klog_flush();
 
-	c_puts( "\n\n***** KERNEL PANIC *****\n\n" );
-	c_printf( "Module: %s\n", module );
+	_kpanic_print( "\n\n***** KERNEL PANIC *****\n\n" );
+	_kpanic_print( "Module: %s\n", module );
 	if( msg != NULL ) {
-		c_puts( msg );
-		c_putchar( '\n' );
+		_kpanic_print( "%s\n", msg );
+	}
+
+	_kpanic_print( "\nKernel traceback:\n" );
+	_kpanic_trace( _get_ebp() );
+
+	if( _current != NULL && _current->context != NULL ) {
+		ctx = _current->context;
+		_kpanic_print( "\nProcess %d context @%08x:\n",
+			       _current->pid, (uint32_t) ctx );
+		_kpanic_print( "  eax %08x ebx %08x ecx %08x edx %08x\n",
+			       ctx->eax, ctx->ebx, ctx->ecx, ctx->edx );
+		_kpanic_print( "  esi %08x edi %08x ebp %08x esp %08x\n",
+			       ctx->esi, ctx->edi, ctx->ebp, ctx->esp );
+		_kpanic_print( "  vec %08x cod %08x efl %08x\n",
+			       ctx->vector, ctx->code, ctx->eflags );
+		_kpanic_print( "  cs %04x ds %04x es %04x fs %04x gs %04x ss %04x\n",
+			       ctx->cs, ctx->ds, ctx->es, ctx->fs, ctx->gs,
+			       ctx->ss );
+		_kpanic_print( "\nProcess traceback:\n" );
+		_kpanic_addr( ctx->eip );
+		_kpanic_trace( ctx->ebp );
 	}
-	//
-	// This might be a good place to do a stack frame
-	// traceback
-	//
 
 	__panic( "KERNEL PANIC" );
 
 }
+
+/*
+** _kpanic_isr - ISR for the processor exceptions
+**
+** usage:  installed with __install_isr() for vectors 0x00-0x1f
+**
+** an exception in the kernel or a process is fatal; panic with a
+** traceback of the code which caused it
+*/
+
+void _kpanic_isr( int vector, int code ) {
+	static char msg[ 48 ];
+
+	c_snprintf( msg, sizeof(msg), "processor exception 0x%02x, code 0x%x",
+		    vector, code );
+	_kpanic( "exception", msg );
+}
@@ -14,19 +14,72 @@
 
 #include "common.h"
 #include "ulib.h"
+#include "stack.h"
 
 /*
 ** PRIVATE DEFINITIONS
 */
 
+// longest output from one printf() call
+
+#define	PRINTF_BUFSIZE	256
+
+// streams per process, and processes which can use the library's
+// per-process state at once
+
+#define	N_STREAMS	4
+#define	N_UPROCS	N_PROCS
+
+// malloc() size classes:  16, 32, ... 2048 bytes, including the
+// block header; larger blocks are kept on a separate list
+
+#define	N_CLASSES	8
+#define	CLASS_SHIFT	4
+#define	CLASS_MAX	(1 << (CLASS_SHIFT + N_CLASSES - 1))
+
+// the heap is extended this much (or a multiple of it) at a time
+
+#define	HEAP_CHUNK	4096
+
 /*
 ** PRIVATE DATA TYPES
 */
 
+// header of a malloc() block; the free lists are linked through
+// the first word after it
+
+typedef struct block {
+	uint32_t	size;		// including this header
+	uint32_t	pad;		// keeps the data 8-byte aligned
+} block_t;
+
+#define	NEXT(b)		(*(block_t **) ((b) + 1))
+
+// the library state of one process
+//
+// All processes share this library's data, so each process' state
+// (stdio streams and malloc() free lists) is kept in a slot of
+// _uprocs claimed the first time it needs one.  A slot is found again
+// by the address range of the process' stack, which costs no system
+// call; the slot is released by exit().  The heap itself is
+// released by the kernel.
+
+typedef struct uproc {
+	uint32_t	stack;			// stack address (0 if free)
+	FILE		files[ N_STREAMS ];	// [0] is stdout
+	block_t		*free[ N_CLASSES ];	// free small blocks by class
+	block_t		*large;			// free large blocks
+	uint8_t		*next;			// unused heap space
+	uint32_t	left;			// and its length
+} uproc_t;
+
 /*
 ** PRIVATE GLOBAL VARIABLES
 */
 
+static uproc_t _uprocs[ N_UPROCS ];
+static uproc_t *_uproc_last;		// most recently found slot
+
 /*
 ** PUBLIC GLOBAL VARIABLES
 */
@@ -35,6 +88,137 @@
 ** PRIVATE FUNCTIONS
 */
 
+/*
+** _uproc_find(claim)
+**
+** locate the library state slot of the calling process; if it has
+** none and 'claim' is set, claim one (stdout starts out line
+** buffered on FD_CONSOLE, and the free lists empty)
+**
+** returns the slot, or NULL
+*/
+
+static uproc_t *_uproc_find( int claim ) {
+	uint32_t sp = (uint32_t) &claim;	// somewhere on our stack
+	uint32_t stack;
+	uproc_t *up;
+
+	up = _uproc_last;
+	if( up != NULL && sp - up->stack < sizeof(stack_t) ) {
+		return( up );
+	}
+
+	for( up = _uprocs; up < _uprocs + N_UPROCS; ++up ) {
+		if( sp - up->stack < sizeof(stack_t) ) {
+			_uproc_last = up;
+			return( up );
+		}
+	}
+
+	if( !claim ) {
+		return( NULL );
+	}
+
+	// other processes may be claiming slots too
+
+	stack = (uint32_t) get_process_info( INFO_STACK, 0 );
+	for( up = _uprocs; up < _uprocs + N_UPROCS; ++up ) {
+		if( __sync_bool_compare_and_swap(&up->stack,0,stack) ) {
+			for( int i = 0; i < N_STREAMS; ++i ) {
+				up->files[i].fd = -1;
+				up->files[i].len = 0;
+			}
+			up->files[0].fd = FD_CONSOLE;
+			up->files[0].mode = _IOLBF;
+			for( int i = 0; i < N_CLASSES; ++i ) {
+				up->free[i] = NULL;
+			}
+			up->large = NULL;
+			up->left = 0;
+			_uproc_last = up;
+			return( up );
+		}
+	}
+
+	return( NULL );
+}
+
+/*
+** _stdio_put(f,buf,len)
+**
+** append 'len' characters to stream 'f', flushing as its buffering
+** mode requires
+**
+** returns 'len', or EOF on error
+*/
+
+static int _stdio_put( FILE *f, char *buf, int len ) {
+	int flush = 0;
+
+	if( f == NULL || f->fd < 0 ) {
+		return( EOF );
+	}
+
+	for( int i = 0; i < len; ++i ) {
+		f->buf[ f->len++ ] = buf[i];
+		if( f->len == BUFSIZ ) {
+			if( fflush(f) == EOF ) {
+				return( EOF );
+			}
+		} else if( buf[i] == '\n' && f->mode == _IOLBF ) {
+			flush = 1;
+		}
+	}
+
+	if( flush || f->mode == _IONBF ) {
+		if( fflush(f) == EOF ) {
+			return( EOF );
+		}
+	}
+
+	return( len );
+}
+
+/*
+** _heap_take(up,size)
+**
+** take 'size' bytes from the unused heap space of 'up', extending the
+** heap if need be
+**
+** returns the space, or NULL if the heap can't grow
+*/
+
+static block_t *_heap_take( uproc_t *up, uint32_t size ) {
+	uint32_t grow;
+	uint8_t *mem;
+	block_t *b;
+
+	while( up->left < size ) {
+		grow = (size - up->left + HEAP_CHUNK - 1) & ~(HEAP_CHUNK - 1);
+		mem = sbrk( grow );
+		if( mem == (uint8_t *) -1 ) {
+			return( NULL );
+		}
+
+		// someone else moved the end of the heap?  start over there
+		// (the old space no longer counts, so the new space may be
+		// too small; if so, go around again for the rest)
+
+		if( mem != up->next + up->left ) {
+			up->next = mem;
+			up->left = 0;
+		}
+		up->left += grow;
+	}
+
+	b = (block_t *) up->next;
+	b->size = size;
+	up->next += size;
+	up->left -= size;
+
+	return( b );
+}
+
 /*
 ** PUBLIC FUNCTIONS
 */
@@ -49,6 +233,168 @@ void __default_exit__( void ) {
 	exit();
 }
 
+/*
+** exit()
+**
+** flush our stdio streams and release our library state, then
+** terminate
+*/
+
+void exit( void ) {
+	uproc_t *io = _uproc_find( 0 );
+
+	if( io != NULL ) {
+		fflush( NULL );
+		io->stack = 0;
+	}
+
+	_exit();
+}
+
+/*
+** __stdout()
+**
+** returns the calling process' stdout stream
+*/
+
+FILE *__stdout( void ) {
+	uproc_t *io = _uproc_find( 1 );
+
+	return( io != NULL ? &io->files[0] : NULL );
+}
+
+/*
+** fdopen(fd,mode)
+**
+** open a stream on descriptor 'fd' with buffering 'mode'
+**
+** returns the stream, or NULL if the process has none free
+*/
+
+FILE *fdopen( int fd, int mode ) {
+	uproc_t *io = _uproc_find( 1 );
+
+	if( io == NULL || fd < 0 || fd >= N_FDS ) {
+		return( NULL );
+	}
+
+	for( int i = 0; i < N_STREAMS; ++i ) {
+		if( io->files[i].fd < 0 ) {
+			io->files[i].fd = fd;
+			io->files[i].mode = mode;
+			io->files[i].len = 0;
+			return( &io->files[i] );
+		}
+	}
+
+	return( NULL );
+}
+
+/*
+** fclose(f)
+**
+** flush and release stream 'f' (stdout can't be released)
+**
+** returns 0, or EOF on error
+*/
+
+int fclose( FILE *f ) {
+	int status = fflush( f );
+
+	if( f != NULL && f != __stdout() ) {
+		f->fd = -1;
+	}
+
+	return( status );
+}
+
+/*
+** fflush(f)
+**
+** write out the buffered contents of 'f', or of all the calling
+** process' streams if 'f' is NULL
+**
+** returns 0, or EOF on error
+*/
+
+int fflush( FILE *f ) {
+	uproc_t *io;
+	int status = 0, n;
+
+	if( f == NULL ) {
+		io = _uproc_find( 0 );
+		if( io != NULL ) {
+			for( int i = 0; i < N_STREAMS; ++i ) {
+				if( io->files[i].fd >= 0 &&
+				    fflush(&io->files[i]) == EOF ) {
+					status = EOF;
+				}
+			}
+		}
+		return( status );
+	}
+
+	if( f->fd < 0 ) {
+		return( EOF );
+	}
+
+	if( f->len > 0 ) {
+		n = write( f->fd, f->buf, f->len );
+		f->len = 0;
+		if( n < 0 ) {
+			status = EOF;
+		}
+	}
+
+	return( status );
+}
+
+/*
+** fputc(c,f), putchar(c)
+**
+** write a character to a stream, or to stdout
+**
+** returns the character, or EOF on error
+*/
+
+int fputc( int c, FILE *f ) {
+	char ch = c;
+
+	return( _stdio_put(f,&ch,1) == EOF ? EOF : (c & 0xff) );
+}
+
+int putchar( int c ) {
+	return( fputc(c,stdout) );
+}
+
+/*
+** fputs(str,f), puts(str)
+**
+** write a string to a stream, or a string and a newline to stdout
+**
+** returns a non-negative number, or EOF on error
+*/
+
+int fputs( char *str, FILE *f ) {
+	int len = 0;
+
+	while( str[len] != '\0' ) {
+		++len;
+	}
+
+	return( _stdio_put(f,str,len) );
+}
+
+int puts( char *str ) {
+	FILE *f = stdout;
+
+	if( fputs(str,f) == EOF ) {
+		return( EOF );
+	}
+
+	return( fputc('\n',f) );
+}
+
 /*
 ** spawn()
 **
@@ -59,6 +405,213 @@ int32_t spawn( void (*entry)(void) ) {
 	return( spawnp(entry,get_process_info(INFO_PRIO,0)) );
 }
 
+/*
+** fprintf(f,fmt,...), printf(fmt,...)
+**
+** format with the console's formatter, and write the result to a
+** stream, or to stdout
+**
+** returns the number of characters written, or EOF on error
+*/
+
+int fprintf( FILE *f, char *fmt, ... ) {
+	char buf[ PRINTF_BUFSIZE ];
+	int n;
+
+	n = c_vsnprintf( buf, sizeof(buf), fmt, &fmt + 1 );
+	if( n >= PRINTF_BUFSIZE ) {
+		n = PRINTF_BUFSIZE - 1;
+	}
+
+	return( _stdio_put(f,buf,n) );
+}
+
+int printf( char *fmt, ... ) {
+	char buf[ PRINTF_BUFSIZE ];
+	int n;
+
+	n = c_vsnprintf( buf, sizeof(buf), fmt, &fmt + 1 );
+	if( n >= PRINTF_BUFSIZE ) {
+		n = PRINTF_BUFSIZE - 1;
+	}
+
+	return( _stdio_put(stdout,buf,n) );
+}
+
+/*
+** brk(addr)
+**
+** set the end of the heap
+**
+** returns 0, or -1 on error
+*/
+
+int brk( void *addr ) {
+	uint8_t *cur = sbrk( 0 );
+
+	if( cur == (uint8_t *) -1 ) {
+		return( -1 );
+	}
+
+	return( sbrk((uint8_t *) addr - cur) == (void *) -1 ? -1 : 0 );
+}
+
+/*
+** malloc(size)
+**
+** allocate a block from the calling process' heap
+**
+** Small blocks come from a free list for their size class, or else
+** from the unused heap space; larger ones are taken first-fit from
+** the large free list, or else from the heap.  The heap is extended
+** by at least HEAP_CHUNK bytes at a time, so most calls make no
+** system call.
+**
+** returns the block, or NULL on error
+*/
+
+void *malloc( uint32_t size ) {
+	uproc_t *up = _uproc_find( 1 );
+	block_t *b, **prev;
+	uint32_t need;
+	int c;
+
+	if( up == NULL || size > 0x7fffffff - sizeof(block_t) ) {
+		return( NULL );
+	}
+
+	need = (size + sizeof(block_t) + 15) & ~15;
+
+	if( need <= CLASS_MAX ) {
+
+		// find the size class, and round up to it
+
+		for( c = 0; (1u << (c + CLASS_SHIFT)) < need; ++c ) {
+			continue;
+		}
+
+		b = up->free[c];
+		if( b != NULL ) {
+			up->free[c] = NEXT(b);
+			return( b + 1 );
+		}
+
+		b = _heap_take( up, 1u << (c + CLASS_SHIFT) );
+		return( b != NULL ? b + 1 : NULL );
+	}
+
+	for( prev = &up->large; (b = *prev) != NULL; prev = &NEXT(b) ) {
+		if( b->size >= need ) {
+			*prev = NEXT(b);
+			return( b + 1 );
+		}
+	}
+
+	b = _heap_take( up, need );
+	return( b != NULL ? b + 1 : NULL );
+}
+
+/*
+** free(ptr)
+**
+** return a block to the calling process' free lists
+*/
+
+void free( void *ptr ) {
+	uproc_t *up;
+	block_t *b = ((block_t *) ptr) - 1;
+	int c;
+
+	if( ptr == NULL || (up = _uproc_find(0)) == NULL ) {
+		return;
+	}
+
+	if( b->size <= CLASS_MAX ) {
+		for( c = 0; (1u << (c + CLASS_SHIFT)) < b->size; ++c ) {
+			continue;
+		}
+		NEXT(b) = up->free[c];
+		up->free[c] = b;
+	} else {
+		NEXT(b) = up->large;
+		up->large = b;
+	}
+}
+
+/*
+** calloc(n,size)
+**
+** allocate a zeroed block for 'n' items of 'size' bytes
+**
+** returns the block, or NULL on error
+*/
+
+void *calloc( uint32_t n, uint32_t size ) {
+	void *p;
+	uint32_t len;
+
+	if( size != 0 && n > 0x7fffffff / size ) {
+		return( NULL );
+	}
+
+	len = n * size;
+	p = malloc( len );
+	if( p != NULL ) {
+		memset( p, 0, len );
+	}
+
+	return( p );
+}
+
+/*
+** realloc(ptr,size)
+**
+** resize a block, moving it if it doesn't have room
+**
+** returns the block, or NULL on error (leaving the old one alone)
+*/
+
+void *realloc( void *ptr, uint32_t size ) {
+	block_t *b = ((block_t *) ptr) - 1;
+	uint8_t *new;
+
+	if( ptr == NULL ) {
+		return( malloc(size) );
+	}
+
+	if( size <= b->size - sizeof(block_t) ) {
+		return( ptr );
+	}
+
+	new = malloc( size );
+	if( new != NULL ) {
+		memcpy( new, ptr, b->size - sizeof(block_t) );
+		free( ptr );
+	}
+
+	return( new );
+}
+
+/*
+** nanosleep()
+**
+** sleep for the whole ticks which certainly end before the deadline
+** (sleep() may return up to one tick early), then spin on the clock
+*/
+
+void nanosleep( uint32_t ns ) {
+	uint64_t deadline = clock_ns() + ns;
+	uint32_t ms = ns / 1000000;
+
+	if( ms > 1 ) {
+		sleep( ms - 1 );
+	}
+
+	while( clock_ns() < deadline ) {
+		continue;
+	}
+}
+
 /*
 ** Integer to string conversion routines
 **
@@ -31,20 +31,34 @@
 **	(0,0) and the lower right corner being (79,24).
 **
 **	The printf provided in both sets of functions has the same
-**	conversion capabilities.  Format codes are of the form:
+**	conversion capabilities (as does c_snprintf, which formats into
+**	a buffer).  Format codes are of the form:
 **
-**		%-0WC
+**		%-0W.PLC
 **
-**	where "-", "0", and "W" are all optional:
+**	where "-", "0", "W", ".P" and "L" are all optional:
 **	  "-" is the left-adjust flag (default is right-adjust)
 **	  "0" is the zero-fill flag (default is space-fill)
 **	  "W" is a number specifying the minimum field width (default: 1 )
+**	  "P" is the precision: the minimum number of digits for an
+**	      integer (zero-fill is then ignored), or the maximum number
+**	      of characters from a string
+**	  "L" is a size: "l" (the same as none) or "ll" (64-bit integer)
 **	and "C" is the conversion type, which must be one of these:
 **	  "c" print a single character
 **	  "s" print a null-terminated string
 **	  "d" print an integer as a decimal value
+**	  "u" print an integer as an unsigned decimal value
 **	  "x" print an integer as a hexadecimal value
 **	  "o" print an integer as a octal value
+**	"%%" prints a "%".
+**
+** Virtual consoles:
+**	There are C_CONSOLES consoles, each with its own screen contents,
+**	scrolling region, cursor and keyboard input.  One of them is shown
+**	on the screen, and gets the keystrokes; Alt-F1, Alt-F2, etc. show
+**	the others.  All the routines here work on console 0, except for
+**	the c_vc_ routines, which take a console number.
 **
 ** Keyboard input:
 **	Two functions are provided: getting a single character and getting
@@ -56,6 +70,11 @@
 #ifndef _C_IO_H_
 #define _C_IO_H_
 
+/*
+** Number of virtual consoles (at most 10, for the Alt-Fn keys)
+*/
+#define	C_CONSOLES	4
+
 /*
 ** Name:	c_io_init
 **
@@ -196,6 +215,121 @@ void c_printf_at( unsigned int x, unsigned int y, char *fmt, ... );
 */
 void c_clearscreen( void );
 
+/*****************************************************************************
+**
+** FORMATTING ROUTINES
+**
+**	These produce the same output as c_printf, but into a buffer.
+**	They may be used by any number of callers at once.
+*/
+
+/*
+** Name:	c_snprintf
+**
+** Description:	Formats into a buffer, storing at most size - 1 characters
+**		followed by a null byte.
+** Arguments:	buffer, size of buffer, printf-style format and optional
+**		values
+** Returns:	the length of the complete output (which was truncated
+**		if this is size or more)
+*/
+int c_snprintf( char *buf, unsigned int size, char *fmt, ... );
+
+/*
+** Name:	c_vsnprintf
+**
+** Description:	As c_snprintf, but the values are found in memory at args
+**		(one word each, two for "ll" conversions), as they are on
+**		the stack after the format in a call to c_snprintf.
+** Arguments:	buffer, size of buffer, printf-style format, values
+** Returns:	the length of the complete output
+*/
+int c_vsnprintf( char *buf, unsigned int size, char *fmt, void *args );
+
+/*****************************************************************************
+**
+** SCREEN UPDATE ROUTINES
+**
+**	The output routines write to a copy of the screen in memory;
+**	the screen itself is only updated by c_flush, which the kernel
+**	calls periodically.  In headless mode (the initial state if
+**	CONSOLE_HEADLESS is defined), the screen is never updated.
+*/
+
+/*
+** Name:	c_flush
+**
+** Description:	Copies the rows which have changed since the last call
+**		to the screen, and moves the cursor.
+*/
+void c_flush( void );
+
+/*
+** Name:	c_flush_needed
+**
+** Description:	Checks whether c_flush has anything to do.
+** Returns:	non-zero if the screen is out of date
+*/
+int c_flush_needed( void );
+
+/*
+** Name:	c_headless
+**
+** Description:	Turns headless mode on or off; turning it off redraws the
+**		whole screen at the next c_flush.
+** Arguments:	non-zero for headless mode
+** Returns:	the previous setting
+*/
+int c_headless( int on );
+
+/*****************************************************************************
+**
+** VIRTUAL CONSOLE ROUTINES
+*/
+
+/*
+** Name:	c_vc_show
+**
+** Description:	Sends the keystrokes to the given console from now
+**		on, and shows it on the screen (at the next c_flush).
+** Arguments:	console number
+*/
+void c_vc_show( unsigned int vc );
+
+/*
+** Name:	c_vc_shown
+**
+** Returns:	the number of the console getting the keystrokes (which
+**		is shown, or will be at the next c_flush)
+*/
+int c_vc_shown( void );
+
+/*
+** Name:	c_vc_putbuf
+**
+** Description:	As c_putbuf, but on the given console.
+** Arguments:	console number, pointer to a buffer, count of characters
+*/
+void c_vc_putbuf( unsigned int vc, char *str, int num );
+
+/*
+** Name:	c_vc_getbuf
+**
+** Description:	As c_getbuf, but from the given console's input.
+** Arguments:	console number, pointer to input buffer, size of buffer
+** Returns:	count of the number of characters read
+*/
+int c_vc_getbuf( unsigned int vc, char *buffer, unsigned int size );
+
+/*
+** Name:	c_vc_input_queue
+**
+** Description:	As c_input_queue, but for the given console's input.
+** Arguments:	console number
+** Returns:	count of the number of characters available
+*/
+int c_vc_input_queue( unsigned int vc );
+
 /*****************************************************************************
 **
 ** INPUT ROUTINES
@@ -246,4 +380,16 @@ int c_gets( char *buffer, unsigned int size );
 */
 int c_input_queue( void );
 
+/*
+** Name:	c_getbuf
+**
+** Description:	This function copies the characters that are already in
+**		the input queue (up to the size of the buffer) without
+**		waiting for more.  The characters are echoed as they
+**		would be by c_getchar.
+** Arguments:	pointer to input buffer, size of buffer
+** Returns:	count of the number of characters copied
+*/
+int c_getbuf( char *buffer, unsigned int size );
+
 #endif
@@ -1,2 +1,52 @@
-int c_strcmp(char *a, char *b);
-unsigned int c_strlen(char *a);
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	c_string.h
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	String library declarations
+**
+** Like the console routines, these may be used by both the kernel and
+** user processes.  Strings are scanned a longword at a time once the
+** pointers are aligned, so the routines may read (but never use) up
+** to three bytes past the end of a string, within the same longword.
+*/
+
+#ifndef _C_STRING_H_
+#define _C_STRING_H_
+
+/*
+** c_strlen(s) - length of 's'
+** c_strnlen(s,max) - length of 's', or 'max' if that is smaller
+*/
+
+unsigned int c_strlen( char *s );
+unsigned int c_strnlen( char *s, unsigned int max );
+
+/*
+** c_strcmp(a,b) - compare two strings
+** c_strncmp(a,b,n) - compare at most 'n' characters of two strings
+**
+** returns <0, 0 or >0 as 'a' is less than, equal to or greater than
+** 'b' (comparing the characters as unsigned)
+*/
+
+int c_strcmp( char *a, char *b );
+int c_strncmp( char *a, char *b, unsigned int n );
+
+/*
+** c_memchr(buf,c,len) - find the first 'c' in 'len' bytes of 'buf'
+** c_strchr(s,c) - find the first 'c' in 's' ('\0' finds the end)
+** c_strstr(s,sub) - find the first 'sub' in 's'
+**
+** return the location found, or NULL
+*/
+
+void *c_memchr( void *buf, int c, unsigned int len );
+char *c_strchr( char *s, int c );
+char *c_strstr( char *s, char *sub );
+
+#endif
@@ -23,6 +23,11 @@
 
 #define	CLOCK_FREQUENCY		1000
 
+// timer slack (in ticks):  initial and maximum values
+
+#define	SLACK_DEFAULT		0
+#define	SLACK_MAX		0xffff
+
 // standard process quantum (in ticks)
 
 #define	QUANTUM_DEFAULT		10
@@ -54,6 +59,10 @@
 
 #define	TICKS_TO_ROUNDED_SECONDS(n)	(((n)+(CLOCK_FREQUENCY-1)) / CLOCK_FREQUENCY)
 
+// nanoseconds per clock tick
+
+#define	NS_PER_TICK		(1000000000 / CLOCK_FREQUENCY)
+
 /*
 ** Types
 */
@@ -76,6 +85,37 @@ extern uint32_t	_system_time;	// the current system time
 
 void _clock_modinit( void );
 
+/*
+** _clock_ns()
+**
+** returns the monotonic time since boot, in nanoseconds
+**
+** The time is interpolated within the current tick using the TSC.
+*/
+
+uint64_t _clock_ns( void );
+
+/*
+** _clock_tsc_ns(tsc)
+**
+** returns the time since boot, in nanoseconds, at which the TSC
+** read 'tsc' (0 for times before the clock was started)
+*/
+
+uint64_t _clock_tsc_ns( uint64_t tsc );
+
+struct pcb;
+
+/*
+** _clock_sleep(pcb,ticks)
+**
+** put 'pcb' on the sleep queue for 'ticks' clock ticks
+**
+** the process may be woken up as many as pcb->slack ticks late
+*/
+
+void _clock_sleep( struct pcb *pcb, uint32_t ticks );
+
 #endif
 
 #endif
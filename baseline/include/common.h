@@ -23,12 +23,18 @@
 
 // maximum number of queues the system will support
 
-#define	N_QUEUES 10
+#define	N_QUEUES 14
 
 // file descriptors for built-in devices
 
 #define	FD_CONSOLE	0
 #define	FD_SIO		1
+#define	FD_NET		2
+#define	FD_PROF		3
+#define	FD_SIO2		4
+#define	FD_SIO3		5
+#define	FD_SIO4		6
+#define	FD_KLOG		7
 
 // information specifiers for get_process_info()
 
@@ -39,6 +45,8 @@
 #define	INFO_PRIO		4
 #define	INFO_QUANTUM		5
 #define	INFO_DEF_QUANTUM	6
+#define	INFO_SLACK		7
+#define	INFO_STACK		8
 
 // information specifiers for get_system_info()
 
@@ -0,0 +1,96 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	defer.h
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Deferred work declarations
+**
+** ISRs should only do what must be done with interrupts disabled
+** (acknowledging the device, moving data out of it) and hand the
+** rest of their work to the deferred work module as a work item.
+** Work items are run in order, with interrupts enabled, by a kernel
+** process running at PRIO_SYSTEM.
+**
+** A work item is owned by its creator (usually a static variable in
+** a driver).  Queueing an item which is already queued does nothing,
+** so an ISR may queue its item on every interrupt; the work function
+** must handle everything that has accumulated since it last ran.
+*/
+
+#ifndef _DEFER_H_
+#define _DEFER_H_
+
+#include "common.h"
+
+/*
+** General (C and/or assembly) definitions
+*/
+
+#ifndef __SP_ASM__
+
+/*
+** Start of C-only definitions
+*/
+
+#ifdef __SP_KERNEL__
+
+// static initializer for a work item
+
+#define	DEFER_INIT(f,a)		{ (f), (a), NULL, 0 }
+
+/*
+** Types
+*/
+
+// a work item
+
+typedef struct defer {
+	void		(*func)( void *arg );	// the work to be done
+	void		*arg;			// its argument
+	struct defer	*next;			// next queued item
+	uint8_t		queued;			// on the work queue?
+} defer_t;
+
+/*
+** Globals
+*/
+
+/*
+** Prototypes
+*/
+
+/*
+** _defer_modinit()
+**
+** initialize the deferred work module
+*/
+
+void _defer_modinit( void );
+
+/*
+** _defer_start()
+**
+** create the deferred work process
+*/
+
+void _defer_start( void );
+
+/*
+** _defer(work)
+**
+** queue a work item to be run by the deferred work process
+**
+** must be called with interrupts disabled
+*/
+
+void _defer( defer_t *work );
+
+#endif
+
+#endif
+
+#endif
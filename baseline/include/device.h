@@ -0,0 +1,248 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	device.h
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Device switch declarations
+**
+** Every character device is described by a device_t holding its
+** operation vector.  Drivers register their devices with the device
+** switch; the read() and write() system calls go through a process'
+** file descriptor table to the device and call its operations with
+** whole buffers.
+**
+** A process' descriptor table is inherited from its parent.  The
+** initial table maps each descriptor to the device with the same
+** number, so registered devices are reachable at their device
+** number (e.g., FD_CONSOLE and FD_SIO).  Each serial port which is
+** present is its own device (FD_SIO for COM1, FD_SIO2 through FD_SIO4).
+** Each virtual console is a device too; spawnc() starts a process
+** with FD_CONSOLE on one of them.
+**
+** ioctl() passes device-specific control requests to a device's
+** ioctl operation.
+**
+** poll() uses each device's poll operation to find out which
+** descriptors are ready.  Drivers call _dev_notify() from their ISRs
+** when a device may have become ready, which wakes any process
+** waiting in poll() on it.
+*/
+
+#ifndef _DEVICE_H_
+#define _DEVICE_H_
+
+#include "common.h"
+
+/*
+** General (C and/or assembly) definitions
+*/
+
+// maximum number of registered devices:  the well-known ones below,
+// and the virtual consoles other than console 0
+
+#define	N_DEVICES	(DEV_VC1 + C_CONSOLES - 1)
+
+// well-known device numbers
+
+#define	DEV_CONSOLE	FD_CONSOLE
+#define	DEV_SIO		FD_SIO
+#define	DEV_NET		FD_NET
+#define	DEV_PROF	FD_PROF
+#define	DEV_SIO2	FD_SIO2
+#define	DEV_SIO3	FD_SIO3
+#define	DEV_SIO4	FD_SIO4
+#define	DEV_KLOG	FD_KLOG
+#define	DEV_VC1		8
+
+// device number of virtual console 'n' (console 0 is the console)
+
+#define	DEV_VC(n)	((n) == 0 ? DEV_CONSOLE : DEV_VC1 + (n) - 1)
+
+// "no device" marker for descriptor table entries
+
+#define	DEV_NONE	0xff
+
+// poll() event flags
+
+#define	POLLIN		0x01	// data can be read
+#define	POLLOUT		0x02	// data can be written
+#define	POLLNVAL	0x04	// not an open descriptor (revents only)
+
+// ioctl() requests for the SIO ports
+
+#define	IOC_SIO_BAUD	0x0101	// set the bit rate (arg:  bits/second)
+#define	IOC_SIO_LINE	0x0102	// set the line format (arg:  see below)
+#define	IOC_SIO_NBIO	0x0103	// set nonblocking writes (arg:  0 or 1)
+#define	IOC_SIO_STATS	0x0104	// get statistics (arg:  sio_stats_t *)
+
+// ioctl() requests for the kernel log (arg:  a KLOG_* level from
+// klog.h; returns the prior level)
+
+#define	IOC_KLOG_CONSOLE	0x0201	// set the console level
+#define	IOC_KLOG_SERIAL	0x0202	// set the SIO level
+
+// SIO line formats:  OR together one of each group
+
+#define	SIO_DATA_5	0x00	// data bits
+#define	SIO_DATA_6	0x01
+#define	SIO_DATA_7	0x02
+#define	SIO_DATA_8	0x03
+#define	SIO_STOP_1	0x00	// stop bits
+#define	SIO_STOP_2	0x04
+#define	SIO_PARITY_NONE	0x00	// parity
+#define	SIO_PARITY_ODD	0x08
+#define	SIO_PARITY_EVEN	0x18
+#define	SIO_PARITY_MARK	0x28
+#define	SIO_PARITY_SPACE	0x38
+
+#ifndef __SP_ASM__
+
+/*
+** Start of C-only definitions
+*/
+
+/*
+** Types
+*/
+
+// one entry in a poll() request
+
+typedef struct pollfd {
+	int32_t		fd;		// descriptor to check
+	uint16_t	events;		// events of interest
+	uint16_t	revents;	// events which are ready
+} pollfd_t;
+
+// SIO port statistics (from IOC_SIO_STATS)
+
+typedef struct sio_stats {
+	uint32_t	rx;		// characters received
+	uint32_t	tx;		// characters transmitted
+	uint32_t	dropped;	// received with the input buffer full
+	uint32_t	errors;		// overrun, parity and framing errors
+	uint32_t	interrupts;	// events serviced by the ISR
+} sio_stats_t;
+
+#ifdef __SP_KERNEL__
+
+#include "process.h"
+
+// a device and its operations
+//
+// read() transfers whatever is available (up to 'count' bytes) and
+// returns the number of bytes moved; write() returns the number of
+// bytes accepted.  Either may return -1 on error.  Operations are
+// never called with a 'count' of 0.  poll() returns the POLLIN and
+// POLLOUT events which are currently ready.  ioctl() returns a
+// request-specific value, or -1 if the request is not supported; it
+// may block the calling process (_current).
+
+typedef struct device {
+	char	*name;		// for reporting
+	int	(*read)( struct device *dev, char *buf, int count );
+	int	(*write)( struct device *dev, char *buf, int count );
+	int	(*poll)( struct device *dev );
+	int	(*ioctl)( struct device *dev, int request, uint32_t arg );
+	void	*data;		// driver private data
+} device_t;
+
+/*
+** Globals
+*/
+
+/*
+** Prototypes
+*/
+
+/*
+** _dev_modinit()
+**
+** initialize the device switch, and register the console
+*/
+
+void _dev_modinit( void );
+
+/*
+** _dev_register(num,dev)
+**
+** register 'dev' as device number 'num'
+**
+** returns the device number, or -1 if it is already in use
+*/
+
+int _dev_register( int num, device_t *dev );
+
+/*
+** _dev_fd_init(pcb,parent)
+**
+** initialize the descriptor table of 'pcb' as a copy of the table
+** of 'parent', or as the initial table if 'parent' is NULL
+*/
+
+void _dev_fd_init( pcb_t *pcb, pcb_t *parent );
+
+/*
+** _dev_lookup(pcb,fd)
+**
+** returns the device open on descriptor 'fd' of 'pcb', or NULL
+*/
+
+device_t *_dev_lookup( pcb_t *pcb, int fd );
+
+/*
+** _dev_read(pcb,fd,buf,count)
+**
+** read up to 'count' bytes from descriptor 'fd' into 'buf'
+**
+** returns the number of bytes read, or -1 on error
+*/
+
+int _dev_read( pcb_t *pcb, int fd, char *buf, int count );
+
+/*
+** _dev_write(pcb,fd,buf,count)
+**
+** write 'count' bytes from 'buf' to descriptor 'fd'; if 'count'
+** is 0, 'buf' is a NUL-terminated string
+**
+** returns the number of bytes written, or -1 on error
+*/
+
+int _dev_write( pcb_t *pcb, int fd, char *buf, int count );
+
+/*
+** _dev_ioctl(pcb,fd,request,arg)
+**
+** perform a control request on descriptor 'fd'
+**
+** returns the device's result, or -1 on error
+*/
+
+int _dev_ioctl( pcb_t *pcb, int fd, int request, uint32_t arg );
+
+/*
+** _dev_poll(pcb)
+**
+** implement the poll() request in the context of 'pcb'
+*/
+
+void _dev_poll( pcb_t *pcb );
+
+/*
+** _dev_notify(dev)
+**
+** called (typically from an ISR) when 'dev' may have become ready;
+** wakes up any process polling it whose request is now satisfied
+*/
+
+void _dev_notify( device_t *dev );
+
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,117 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	ipc.h
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Synchronous message passing declarations
+**
+** Messages are rendezvous-style:  send() blocks until the receiver
+** takes the message, and receive() blocks until a message arrives.
+**
+** A message is five longwords.  The send() and receive() library
+** stubs carry all five in EBX, ECX, EDX, ESI and EDI, so the kernel
+** moves a message by copying registers from one context save area
+** to another; message memory is never touched by the kernel.
+**
+** If 'npages' is non-zero, ownership of that many pages starting at
+** 'pages' (which the sender must own) moves to the receiver along
+** with the message, so large data is transferred without copying.
+*/
+
+#ifndef _IPC_H_
+#define _IPC_H_
+
+#include "types.h"
+
+/*
+** General (C and/or assembly) definitions
+*/
+
+// number of inline data words in a message
+
+#define	MSG_WORDS	3
+
+// byte offsets of the message fields (used by the library stubs)
+
+#define	MSG_W0		0
+#define	MSG_W1		4
+#define	MSG_W2		8
+#define	MSG_PAGES	12
+#define	MSG_NPAGES	16
+
+// receive() from any sender
+
+#define	IPC_ANY		0
+
+// IPC wait states
+
+#define	IPC_NONE	0
+#define	IPC_SENDING	1
+#define	IPC_RECEIVING	2
+
+#ifndef __SP_ASM__
+
+/*
+** Start of C-only definitions
+*/
+
+/*
+** Types
+*/
+
+// a message
+//
+// NOTE:  the layout must match the MSG_* offsets above!!!
+
+typedef struct msg {
+	uint32_t	w[ MSG_WORDS ];	// inline data
+	void		*pages;		// first page to transfer, or NULL
+	uint32_t	npages;		// number of pages to transfer
+} msg_t;
+
+#ifdef __SP_KERNEL__
+
+#include "process.h"
+
+/*
+** Globals
+*/
+
+/*
+** Prototypes
+*/
+
+/*
+** _ipc_send(pcb)
+**
+** send the message in the context of 'pcb' to the PID given as
+** its first syscall argument
+*/
+
+void _ipc_send( pcb_t *pcb );
+
+/*
+** _ipc_receive(pcb)
+**
+** receive a message into the context of 'pcb'
+*/
+
+void _ipc_receive( pcb_t *pcb );
+
+/*
+** _ipc_release(pcb)
+**
+** clean up IPC state for a process which is exiting
+*/
+
+void _ipc_release( pcb_t *pcb );
+
+#endif
+
+#endif
+
+#endif
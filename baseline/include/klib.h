@@ -45,6 +45,50 @@
 
 uint32_t _get_ebp( void );
 
+/*
+** _rdtsc - return the current contents of the time stamp counter
+*/
+
+uint64_t _rdtsc( void );
+
+/*
+** _muldiv - compute (a * b) / c using a 64-bit intermediate product
+**
+** usage:  q = _muldiv( a, b, c )
+**
+** the quotient must fit in 32 bits
+*/
+
+uint32_t _muldiv( uint32_t a, uint32_t b, uint32_t c );
+
+/*
+** _udiv64 - divide a 64-bit value by a 32-bit value
+**
+** usage:  q = _udiv64( n, d )
+**
+** the quotient must fit in 32 bits
+*/
+
+uint32_t _udiv64( uint64_t n, uint32_t d );
+
+/*
+** _int_disable - disable interrupts
+**
+** usage:  flags = _int_disable()
+**
+** returns the prior contents of EFLAGS, for _int_restore()
+*/
+
+uint32_t _int_disable( void );
+
+/*
+** _int_restore - restore the interrupt state saved by _int_disable()
+**
+** usage:  _int_restore( flags )
+*/
+
+void _int_restore( uint32_t flags );
+
 /*
 ** _put_char_or_code( ch )
 **
@@ -54,25 +98,76 @@ uint32_t _get_ebp( void );
 
 void _put_char_or_code( int ch );
 
+/*
+** _mem_modinit - select the memory block routines
+**
+** uses SSE2 for large blocks if the CPU has it
+*/
+
+void _mem_modinit( void );
+
 /*
 ** _memset - initialize all bytes of a block of memory to a value
 **
 ** usage:  _memset( buffer, length, value )
+**
+** returns the buffer address
+*/
+
+void *_memset( uint8_t *buf, uint32_t len, uint8_t value );
+
+/*
+** _memcpy - copy a block of memory
+**
+** usage:  _memcpy( dst, src, length )
+**
+** the blocks must not overlap; returns the destination address
+*/
+
+void *_memcpy( uint8_t *dst, uint8_t *src, uint32_t len );
+
+/*
+** _memmove - copy a block of memory which may overlap the destination
+**
+** usage:  _memmove( dst, src, length )
+**
+** returns the destination address
+*/
+
+void *_memmove( uint8_t *dst, uint8_t *src, uint32_t len );
+
+/*
+** _memcmp - compare two blocks of memory
+**
+** usage:  n = _memcmp( a, b, length )
+**
+** returns <0, 0 or >0 as the first differing byte of 'a' is less
+** than, equal to or greater than that of 'b'
 */
 
-void _memset( register uint8_t *buf, register uint32_t len, register uint8_t value );
+int _memcmp( uint8_t *a, uint8_t *b, uint32_t len );
 
 /*
 ** _kpanic - kernel-level panic routine
 **
 ** usage:  _kpanic( module, msg )
 **
-** Prefix routine for __panic() - can be expanded to do other things
-** (e.g., printing a stack traceback)
+** Prefix routine for __panic():  prints a symbolic traceback and
+** the current process' context on the console and the SIO
 */
 
 void _kpanic( char *mod, char *msg );
 
+/*
+** _kpanic_isr - ISR for the processor exceptions
+**
+** usage:  __install_isr( vector, _kpanic_isr )
+**
+** panics with a traceback of the code which caused the exception
+*/
+
+void _kpanic_isr( int vector, int code );
+
 #endif
 
 #endif
@@ -0,0 +1,108 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	klog.h
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Kernel log declarations
+**
+** _klog() appends a record to the kernel log ring without formatting
+** it:  the record holds the TSC, the severity, the format string and
+** the first KLOG_ARGS argument words, so logging is cheap enough to
+** do from ISRs.  The deferred work process later formats the new
+** records and sends those at or above each sink's level to the
+** console and the SIO.  The ring can be read back as text (dmesg)
+** from the log device (FD_KLOG).
+**
+** Because records are formatted later, %s arguments must point to
+** strings which don't change (literals, device names, etc.).
+*/
+
+#ifndef _KLOG_H_
+#define _KLOG_H_
+
+#include "common.h"
+
+/*
+** General (C and/or assembly) definitions
+*/
+
+// severity levels (lower is more severe)
+
+#define	KLOG_OFF	-1	// as a sink level:  print nothing
+#define	KLOG_ERR	0
+#define	KLOG_WARN	1
+#define	KLOG_INFO	2
+#define	KLOG_DEBUG	3
+
+// number of records in the ring (a power of two)
+
+#define	KLOG_RECORDS	512
+
+// argument words kept for each record
+
+#define	KLOG_ARGS	6
+
+// initial sink levels
+
+#define	KLOG_CONSOLE_LEVEL	KLOG_INFO
+#define	KLOG_SERIAL_LEVEL	KLOG_WARN
+
+#ifndef __SP_ASM__
+
+/*
+** Start of C-only definitions
+*/
+
+/*
+** Types
+*/
+
+/*
+** Globals
+*/
+
+/*
+** Prototypes
+*/
+
+#ifdef __SP_KERNEL__
+
+/*
+** _klog_modinit()
+**
+** initialize the kernel log, and register its device
+*/
+
+void _klog_modinit( void );
+
+/*
+** _klog(level,fmt,...)
+**
+** append a record to the kernel log
+**
+** 'fmt' takes the c_printf() conversions, with at most KLOG_ARGS
+** argument words in all; each message is one line, and a trailing
+** newline is optional.  May be called from ISRs.
+*/
+
+void _klog( int level, char *fmt, ... );
+
+/*
+** _klog_flush()
+**
+** send any records not yet printed to the sinks
+**
+** normally done by deferred work; called directly by _kpanic()
+*/
+
+void _klog_flush( void );
+
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,104 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	ktimer.h
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Kernel timer declarations
+**
+** A kernel timer calls a function at (or shortly after) a given
+** time on the _clock_ns() clock.  Callbacks are run by the deferred
+** work process, with interrupts enabled; timers have clock tick
+** resolution.  A timer may be re-armed from its own callback.
+*/
+
+#ifndef _KTIMER_H_
+#define _KTIMER_H_
+
+#include "common.h"
+
+/*
+** General (C and/or assembly) definitions
+*/
+
+// number of slots in the timer wheel (must be a power of two)
+
+#define	KTIMER_SLOTS	256
+
+#ifndef __SP_ASM__
+
+/*
+** Start of C-only definitions
+*/
+
+#ifdef __SP_KERNEL__
+
+/*
+** Types
+*/
+
+// a kernel timer
+//
+// owned by the caller; the fields are private to the ktimer module
+
+typedef struct ktimer {
+	struct ktimer	*next;		// wheel slot list links
+	struct ktimer	*prev;
+	uint32_t	expires;	// expiration time, in ticks
+	void		(*func)( void *arg );	// callback
+	void		*arg;		// its argument
+	uint8_t		armed;		// on the wheel?
+} ktimer_t;
+
+/*
+** Globals
+*/
+
+/*
+** Prototypes
+*/
+
+/*
+** _ktimer_modinit()
+**
+** initialize the kernel timer module
+*/
+
+void _ktimer_modinit( void );
+
+/*
+** _ktimer_arm(timer,expires_ns,func,arg)
+**
+** arrange for func(arg) to be called once _clock_ns() reaches
+** 'expires_ns'; an already-armed timer is re-armed
+*/
+
+void _ktimer_arm( ktimer_t *timer, uint64_t expires_ns,
+		  void (*func)(void *), void *arg );
+
+/*
+** _ktimer_cancel(timer)
+**
+** disarm a timer
+**
+** returns 1 if the timer was armed, else 0
+*/
+
+int _ktimer_cancel( ktimer_t *timer );
+
+/*
+** _ktimer_tick()
+**
+** called by the clock ISR after the system time is advanced
+*/
+
+void _ktimer_tick( void );
+
+#endif
+
+#endif
+
+#endif
@@ -171,6 +171,9 @@ typedef struct txd_s {
 #define SCB_CMD_TRANS           0x0004
 
 #define RFD_BYTE_WRITTEN_MASK   0x3F
+#define RFD_ACTUAL_COUNT_MASK   0x3FFF  // bytes received, header included
+
+#define NET_RXQ_LEN             8   // frames queued for the net device
 /*
 ** Initialize 
 ** Return: 0 on Success, <0 on Error
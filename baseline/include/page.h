@@ -0,0 +1,137 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	page.h
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Physical page pool declarations
+**
+** We have no paging hardware support, so "pages" are simply
+** page-sized, page-aligned blocks of physical memory carved out
+** of a reserved region above the kernel image.  Each page records
+** the PID of the process that owns it (or PAGE_OWNER_KERNEL).
+*/
+
+#ifndef _PAGE_H_
+#define _PAGE_H_
+
+#include "common.h"
+
+/*
+** General (C and/or assembly) definitions
+*/
+
+// size of a page, in bytes
+
+#define	PAGE_SIZE	4096
+#define	PAGE_SHIFT	12
+
+// the reserved region:  starts at 1MB, up to 4MB long
+
+#define	PAGE_POOL_BASE		0x00100000
+#define	PAGE_POOL_MAX_PAGES	1024
+
+// owner values that aren't PIDs
+
+#define	PAGE_OWNER_NONE		0
+#define	PAGE_OWNER_KERNEL	(-1)
+
+#ifndef __SP_ASM__
+
+/*
+** Start of C-only definitions
+*/
+
+// pseudo function to convert a byte count to a (rounded up) page count
+
+#define	BYTES_TO_PAGES(n)	(((n) + PAGE_SIZE - 1) >> PAGE_SHIFT)
+
+/*
+** Types
+*/
+
+/*
+** Globals
+*/
+
+/*
+** Prototypes
+*/
+
+/*
+** _page_modinit()
+**
+** initialize the page pool
+*/
+
+void _page_modinit( void );
+
+/*
+** _page_alloc(npages,owner)
+**
+** allocate 'npages' physically contiguous pages for 'owner'
+**
+** returns the address of the first page, or NULL on failure
+*/
+
+void *_page_alloc( uint32_t npages, int16_t owner );
+
+/*
+** _page_free(addr,npages)
+**
+** return 'npages' pages starting at 'addr' to the pool
+*/
+
+void _page_free( void *addr, uint32_t npages );
+
+/*
+** _page_owner(addr)
+**
+** returns the owner of the page containing 'addr', or
+** PAGE_OWNER_NONE if it is free or not in the pool
+*/
+
+int16_t _page_owner( void *addr );
+
+/*
+** _page_owns(addr,npages,owner)
+**
+** determine whether 'owner' owns all of a page-aligned range of
+** 'npages' (at least one) pages starting at 'addr'
+*/
+
+bool_t _page_owns( void *addr, uint32_t npages, int16_t owner );
+
+/*
+** _page_chown(addr,npages,owner)
+**
+** give 'npages' pages starting at 'addr' to a new owner
+*/
+
+void _page_chown( void *addr, uint32_t npages, int16_t owner );
+
+/*
+** _page_claim(addr,npages,owner)
+**
+** give 'npages' pages starting at 'addr' to 'owner' if they are
+** all free
+**
+** returns 1 on success, else 0
+*/
+
+bool_t _page_claim( void *addr, uint32_t npages, int16_t owner );
+
+/*
+** _page_release(owner)
+**
+** return every page belonging to 'owner' to the pool
+*/
+
+void _page_release( int16_t owner );
+
+#endif
+
+#endif
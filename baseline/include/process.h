@@ -19,9 +19,10 @@
 ** General (C and/or assembly) definitions
 */
 
-// number of user pcbs includes one for the idle process
+// number of pcbs includes one for the idle process and one for
+// the deferred work process
 
-#define	N_PCBS		(N_PROCS + 1)
+#define	N_PCBS		(N_PROCS + 2)
 
 // process states include a six-bit state value and two "flag" bits
 
@@ -49,6 +50,14 @@
 #define	N_PRIOS		4
 #define	PRIO_LAST	PRIO_USER_LOW
 
+// size of the per-process file descriptor table
+
+#define	N_FDS		8
+
+// pages reserved for a process' heap by its first sbrk()
+
+#define	HEAP_PAGES	16
+
 // PID of the initial user process
 
 #define	PID_INIT	1
@@ -111,16 +120,26 @@ typedef struct pcb {
 	context_t	*context;	// context save area pointer
 	stack_t		*stack;		// per-process runtime stack
 	uint32_t	wakeup;		// for sleeping processes
+	uint32_t	shm_mask;	// attached shared memory segments
+	struct pcb	*ipc_next;	// next process in a sender list
+	struct pcb	*ipc_senders;	// processes blocked sending to us
+	uint32_t	heap;		// start of the heap (0 if none yet)
+	uint32_t	brk;		// current end of the heap
+	uint32_t	heap_pages;	// pages owned by the heap
 
 	// 16-bit fields
 	int16_t		pid;		// our pid
 	int16_t		ppid;		// out parent's pid
+	uint16_t	slack;		// timer slack for sleeps (ticks)
 
 	// 8-bit fields
 	uint8_t		prio;		// our priority (MLQ level)
 	uint8_t		state;		// current process state
 	uint8_t		quantum;	// remaining execution quantum
 	uint8_t		default_quantum;	// default for this process
+	uint8_t		ipc_wait;	// IPC wait state
+	uint8_t		poll_wait;	// blocked in poll()?
+	uint8_t		fds[ N_FDS ];	// device numbers of open descriptors
 } pcb_t;
 
 /*
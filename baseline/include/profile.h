@@ -0,0 +1,90 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	profile.h
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Sampling profiler declarations
+**
+** When the system is built with PROFILE defined, every clock tick
+** records where the interrupted process was executing.  The samples
+** are read back as text from the profiler device (FD_PROF), and are
+** turned into a symbolic profile on the host by ProfSym, using the
+** kernel's name list (prog.sym).
+*/
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "common.h"
+
+/*
+** General (C and/or assembly) definitions
+*/
+
+// histogram granularity:  each bucket covers 2^PROF_SHIFT bytes of text
+
+#define	PROF_SHIFT	4
+
+// number of histogram buckets (enough for 128KB of text)
+
+#define	PROF_BUCKETS	8192
+
+// number of distinct PIDs counted
+
+#define	PROF_PIDS	32
+
+// number of recent samples kept with their call chains
+
+#define	PROF_RING	512
+
+// return addresses recorded for each call chain
+
+#define	PROF_DEPTH	6
+
+#ifndef __SP_ASM__
+
+/*
+** Start of C-only definitions
+*/
+
+/*
+** Types
+*/
+
+/*
+** Globals
+*/
+
+/*
+** Prototypes
+*/
+
+#ifdef __SP_KERNEL__
+
+/*
+** _prof_modinit()
+**
+** initialize the profiler, and register its device
+**
+** does nothing unless PROFILE is defined
+*/
+
+void _prof_modinit( void );
+
+/*
+** _prof_sample()
+**
+** called by the clock ISR to take a sample of the current process
+*/
+
+void _prof_sample( void );
+
+#endif
+
+#endif
+
+#endif
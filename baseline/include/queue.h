@@ -117,6 +117,16 @@ void _queue_insert( queue_t queue, void *data, void *key );
 
 void *_queue_remove( queue_t queue );
 
+/*
+** _queue_delete(que,data)
+**
+** remove a specific element from the queue
+**
+** returns the thing that was removed, or NULL if it wasn't there
+*/
+
+void *_queue_delete( queue_t queue, void *data );
+
 /*
 ** _queue_kpeek(que)
 **
@@ -42,6 +42,7 @@
 
 extern pcb_t *_current;		// the currently-running process
 extern queue_t _ready[];	// the MLQ ready queue structure
+extern uint8_t _need_resched;	// check for preemption at ISR exit?
 
 /*
 ** Prototypes
@@ -71,6 +72,24 @@ void _schedule( pcb_t *pcb );
 
 void _dispatch( void );
 
+/*
+** _dispatch_to(pcb)
+**
+** give the CPU directly to a specific process, bypassing the
+** ready queues (the process must not be on one of them)
+*/
+
+void _dispatch_to( pcb_t *pcb );
+
+/*
+** _resched()
+**
+** preempt the current process if a higher-priority one is ready;
+** called at ISR exit when _need_resched has been set
+*/
+
+void _resched( void );
+
 #endif
 
 #endif
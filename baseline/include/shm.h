@@ -0,0 +1,103 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	shm.h
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Shared memory segment declarations
+**
+** A segment is a run of contiguous pages from the page pool.  As
+** there is no paging hardware support, every process that attaches
+** a segment sees it at the same (physical) address.
+*/
+
+#ifndef _SHM_H_
+#define _SHM_H_
+
+#include "common.h"
+
+/*
+** General (C and/or assembly) definitions
+*/
+
+// maximum number of segments (must fit in the PCB attach mask)
+
+#define	N_SHMSEGS	32
+
+#ifndef __SP_ASM__
+
+/*
+** Start of C-only definitions
+*/
+
+#ifdef __SP_KERNEL__
+
+#include "process.h"
+
+/*
+** Types
+*/
+
+/*
+** Globals
+*/
+
+/*
+** Prototypes
+*/
+
+/*
+** _shm_modinit()
+**
+** initialize the shared memory module
+*/
+
+void _shm_modinit( void );
+
+/*
+** _shm_create(pcb,size)
+**
+** create a segment of at least 'size' bytes, attached to 'pcb'
+**
+** returns the segment id, or -1 on failure
+*/
+
+int _shm_create( pcb_t *pcb, uint32_t size );
+
+/*
+** _shm_attach(pcb,id)
+**
+** attach segment 'id' to 'pcb'
+**
+** returns the address of the segment, or NULL on failure
+*/
+
+void *_shm_attach( pcb_t *pcb, int id );
+
+/*
+** _shm_detach(pcb,id)
+**
+** detach segment 'id' from 'pcb', releasing it if this was the
+** last attached process
+**
+** returns 0 on success, -1 on failure
+*/
+
+int _shm_detach( pcb_t *pcb, int id );
+
+/*
+** _shm_release(pcb)
+**
+** detach all segments attached to 'pcb'
+*/
+
+void _shm_release( pcb_t *pcb );
+
+#endif
+
+#endif
+
+#endif
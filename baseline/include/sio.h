@@ -42,7 +42,7 @@
 /*
 ** _sio_modinit()
 **
-** Initialize the UART chip.
+** Initialize the UART chips.
 */
 
 void _sio_modinit( void );
@@ -54,9 +54,9 @@ void _sio_modinit( void );
 **
 ** usage:       old = _sio_enable( which )
 **
-** enables interrupts according to the 'which' parameter
+** enables interrupts on every port according to the 'which' parameter
 **
-** returns the prior settings
+** returns the prior settings (of COM1)
 */
 
 uint8_t _sio_enable( uint8_t which );
@@ -68,9 +68,9 @@ uint8_t _sio_enable( uint8_t which );
 **
 ** usage:       old = _sio_disable( which )
 **
-** disables interrupts according to the 'which' parameter
+** disables interrupts on every port according to the 'which' parameter
 **
-** returns the prior settings
+** returns the prior settings (of COM1)
 */
 
 uint8_t _sio_disable( uint8_t which );
@@ -146,10 +146,23 @@ int _sio_writes( char *buffer, int length );
 
 int _sio_puts( char *buffer );
 
+/*
+** _sio_panic_puts( buf )
+**
+** write a NUL-terminated buffer of characters to the serial output
+** by polling the transmitter, after any output still buffered
+**
+** usage:	_sio_panic_puts( char *buffer );
+**
+** for _kpanic(); works with interrupts disabled
+*/
+
+void _sio_panic_puts( char *buffer );
+
 /*
 ** _sio_dump()
 **
-** dump the contents of the SIO buffers
+** dump the contents of the SIO buffers, and the port statistics
 */
 
 void _sio_dump( void );
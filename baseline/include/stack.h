@@ -30,8 +30,9 @@
 #define	STACK_LWORDS	1024
 
 // number of stacks to create includes one for the idle process
+// and one for the deferred work process
 
-#define	N_STACKS	(N_PROCS)
+#define	N_STACKS	(N_PROCS + 1)
 
 /*
 ** Types
@@ -28,10 +28,23 @@
 #define	SYS_write		4
 #define	SYS_get_process_info	5
 #define	SYS_get_system_info	6
+#define	SYS_shm_create		7
+#define	SYS_shm_attach		8
+#define	SYS_shm_detach		9
+#define	SYS_send		10
+#define	SYS_receive		11
+#define	SYS_page_alloc		12
+#define	SYS_page_free		13
+#define	SYS_poll		14
+#define	SYS_clock_ns		15
+#define	SYS_sleep_slack		16
+#define	SYS_ioctl		17
+#define	SYS_spawnc		18
+#define	SYS_sbrk		19
 
 // number of "real" system calls
 
-#define	N_SYSCALLS	7
+#define	N_SYSCALLS	20
 
 // dummy system call code to test the syscall ISR
 
@@ -42,6 +42,9 @@ typedef uint16_t	ushort_t;
 typedef long		int32_t;
 typedef unsigned long	uint32_t;
 
+typedef long long		int64_t;
+typedef unsigned long long	uint64_t;
+
 typedef _Bool		bool_t;
 
 #ifdef __SP_KERNEL__
@@ -23,9 +23,21 @@
 ** General (C and/or assembly) definitions
 */
 
+// stdio buffer size, and buffering modes
+
+#define	BUFSIZ		128
+
+#define	_IOFBF		0	// full buffering
+#define	_IOLBF		1	// flushed at each newline
+#define	_IONBF		2	// no buffering
+
+#define	EOF		(-1)
+
 #ifndef __SP_ASM__
 
 #include "process.h"
+#include "ipc.h"
+#include "device.h"
 
 /*
 ** Start of C-only definitions
@@ -35,6 +47,19 @@
 ** Types
 */
 
+// a stdio stream:  buffered output to a file descriptor
+
+typedef struct file {
+	int	fd;		// descriptor (-1 if not open)
+	int	mode;		// _IOFBF, _IOLBF or _IONBF
+	int	len;		// characters in buf
+	char	buf[ BUFSIZ ];
+} FILE;
+
+// each process' standard output (FD_CONSOLE, line buffered)
+
+#define	stdout	(__stdout())
+
 /*
 ** Globals
 */
@@ -61,6 +86,111 @@ int itos8( char *buf, int value, int store_all );
 
 int itos16( char *buf, int value, int store_all );
 
+/*
+** memset, memcpy, memmove, memcmp - memory block operations
+**
+** the usual C library functions (memcpy's blocks must not overlap);
+** these share the kernel's implementations
+*/
+
+void *memset( void *buf, int value, uint32_t len );
+void *memcpy( void *dst, void *src, uint32_t len );
+void *memmove( void *dst, void *src, uint32_t len );
+int memcmp( void *a, void *b, uint32_t len );
+
+/*
+** Buffered output (stdio)
+**
+** Each process has its own streams, so these may be used by any
+** number of processes at once (but a stream must not be shared).
+** A process' streams are flushed when it exits; write() on a
+** descriptor isn't ordered with output buffered in a stream on it.
+*/
+
+/*
+** __stdout() - the calling process' stdout stream (see 'stdout')
+*/
+
+FILE *__stdout( void );
+
+/*
+** fdopen - open a stream on a descriptor
+**
+** usage:	f = fdopen( fd, mode );
+**
+** 'mode' is the buffering mode (_IOFBF, _IOLBF or _IONBF); each
+** process can have a few streams (including stdout) open at once
+**
+** returns:
+**      the stream, or NULL on error
+*/
+
+FILE *fdopen( int fd, int mode );
+
+/*
+** fclose - flush and close a stream
+**
+** usage:	n = fclose( f );
+**
+** returns:
+**      0, or EOF on error
+*/
+
+int fclose( FILE *f );
+
+/*
+** fflush - write out buffered output
+**
+** usage:	n = fflush( f );
+**
+** if 'f' is NULL, flushes all the streams of the calling process
+**
+** returns:
+**      0, or EOF on error
+*/
+
+int fflush( FILE *f );
+
+/*
+** fputc, putchar - write a character to a stream, or to stdout
+**
+** usage:	n = fputc( c, f );  n = putchar( c );
+**
+** returns:
+**      the character, or EOF on error
+*/
+
+int fputc( int c, FILE *f );
+int putchar( int c );
+
+/*
+** fputs, puts - write a string to a stream, or a string and a
+** newline to stdout
+**
+** usage:	n = fputs( str, f );  n = puts( str );
+**
+** returns:
+**      a non-negative number, or EOF on error
+*/
+
+int fputs( char *str, FILE *f );
+int puts( char *str );
+
+/*
+** fprintf, printf - formatted output to a stream, or to stdout
+**
+** usage:	n = fprintf( f, fmt, ... );  n = printf( fmt, ... );
+**
+** takes the c_printf() conversions; output is limited to 255
+** characters per call
+**
+** returns:
+**      the number of characters written, or EOF on error
+*/
+
+int fprintf( FILE *f, char *fmt, ... );
+int printf( char *fmt, ... );
+
 /*
 ** default exit routine for processes
 */
@@ -72,11 +202,21 @@ void __default_exit__( void );
 **
 ** usage:	exit();
 **
-** does not return
+** flushes the process' stdio streams; does not return
 */
 
 void exit( void );
 
+/*
+** _exit - terminate the calling process without flushing its streams
+**
+** usage:	_exit();
+**
+** does not return
+*/
+
+void _exit( void );
+
 /*
 ** spawn - create a new process running a different program
 **
@@ -99,6 +239,20 @@ int32_t spawn( void (*entry)(void) );
 
 int32_t spawnp( void (*entry)(void), uint8_t prio );
 
+/*
+** spawnc - create a new process on a virtual console
+**
+** usage:	pid = spawnc(entry,prio,console);
+**
+** as spawnp(), but FD_CONSOLE in the new process (and so in its
+** children) is virtual console 'console' (0 to C_CONSOLES-1)
+**
+** returns:
+**	pid of the spawned process, or -1 on failure
+*/
+
+int32_t spawnc( void (*entry)(void), uint8_t prio, uint32_t console );
+
 /*
 ** sleep - put the current process to sleep for some length of time
 **
@@ -111,6 +265,20 @@ int32_t spawnp( void (*entry)(void), uint8_t prio );
 
 void sleep( uint32_t ms );
 
+/*
+** sleep_slack - sleep, allowing the wakeup to be late
+**
+** usage:	sleep_slack(ms,slack);
+**
+** sets the timer slack of the process to 'slack' milliseconds, then
+** sleeps as sleep() does.  A process may be woken up to 'slack' ms
+** after its wakeup time, so that its wakeup can share a clock tick
+** with other sleepers.  The setting applies to later sleeps (and
+** poll() timeouts) too, and is inherited by spawned processes.
+*/
+
+void sleep_slack( uint32_t ms, uint32_t slack );
+
 /*
 ** read - read from the console or SIO
 **
@@ -137,6 +305,100 @@ int read( int fd, char *buf, int size );
 
 int write( int fd, char *buf, int size );
 
+/*
+** ioctl - perform a device control request
+**
+** usage:	n = ioctl( fd, request, arg );
+**
+** the requests understood depend on the device (e.g., IOC_SIO_BAUD
+** and IOC_SIO_LINE for the SIO)
+**
+** returns:
+**      a request-specific value, or -1 on error
+*/
+
+int ioctl( int fd, int request, uint32_t arg );
+
+/*
+** poll - wait for descriptors to become ready
+**
+** usage:	n = poll( fds, nfds, timeout );
+**
+** for each of the 'nfds' entries in 'fds', sets 'revents' to the
+** subset of 'events' (POLLIN, POLLOUT) which are ready; if none are,
+** blocks until one is or 'timeout' milliseconds have passed.  A
+** 'timeout' of 0 never blocks; a negative 'timeout' waits forever.
+**
+** returns:
+**      the number of ready descriptors (0 on timeout), or -1 on error
+*/
+
+int poll( pollfd_t *fds, int nfds, int32_t timeout );
+
+/*
+** clock_ns - read the high-resolution clock
+**
+** usage:	ns = clock_ns();
+**
+** returns:
+**      the monotonic time since boot, in nanoseconds
+*/
+
+uint64_t clock_ns( void );
+
+/*
+** nanosleep - delay for a precise length of time
+**
+** usage:	nanosleep(ns);
+**
+** sleeps for whole clock ticks, then busy-waits for the remainder
+*/
+
+void nanosleep( uint32_t ns );
+
+/*
+** sbrk - move the end of the heap
+**
+** usage:	ptr = sbrk( incr );
+**
+** the heap starts out empty, and grows or shrinks by 'incr' bytes;
+** it is released when the process exits
+**
+** returns:
+**      the previous end of the heap, or (void *) -1 on error
+*/
+
+void *sbrk( int32_t incr );
+
+/*
+** brk - set the end of the heap
+**
+** usage:	n = brk( addr );
+**
+** returns:
+**      0, or -1 on error
+*/
+
+int brk( void *addr );
+
+/*
+** malloc, calloc, realloc, free - heap memory allocation
+**
+** usage:	ptr = malloc( size );  ptr = calloc( n, size );
+**		ptr = realloc( ptr, size );  free( ptr );
+**
+** blocks come from the calling process' own heap, and may only be
+** freed by that process; most calls don't need a system call
+**
+** returns:
+**      the block, or NULL on error
+*/
+
+void *malloc( uint32_t size );
+void *calloc( uint32_t n, uint32_t size );
+void *realloc( void *ptr, uint32_t size );
+void free( void *ptr );
+
 /*
 ** get_process_info - retrieve information about a process
 **
@@ -161,6 +423,96 @@ int32_t get_process_info( uint32_t what, uint16_t who );
 
 int32_t get_system_info( uint32_t what );
 
+/*
+** shm_create - create a shared memory segment
+**
+** usage:	id = shm_create( size );
+**
+** the calling process is attached to the new segment
+**
+** returns:
+**      the segment id, or -1 on error
+*/
+
+int shm_create( uint32_t size );
+
+/*
+** shm_attach - attach a shared memory segment
+**
+** usage:	ptr = shm_attach( id );
+**
+** returns:
+**      the address of the segment, or NULL on error
+*/
+
+void *shm_attach( int id );
+
+/*
+** shm_detach - detach a shared memory segment
+**
+** usage:	n = shm_detach( id );
+**
+** the segment is released when the last process detaches it
+**
+** returns:
+**      0 on success, or -1 on error
+*/
+
+int shm_detach( int id );
+
+/*
+** page_alloc - allocate physically contiguous pages
+**
+** usage:	ptr = page_alloc( npages );
+**
+** the pages belong to the calling process until they are freed,
+** sent to another process, or the process exits
+**
+** returns:
+**      the address of the first page, or NULL on error
+*/
+
+void *page_alloc( uint32_t npages );
+
+/*
+** page_free - release pages
+**
+** usage:	n = page_free( ptr, npages );
+**
+** returns:
+**      0 on success, or -1 if the caller doesn't own the pages
+*/
+
+int page_free( void *addr, uint32_t npages );
+
+/*
+** send - send a message to another process
+**
+** usage:	n = send( pid, &msg );
+**
+** blocks until the receiver takes the message; if msg.npages is
+** non-zero, ownership of those pages passes to the receiver
+**
+** returns:
+**      0 on success, or -1 on error
+*/
+
+int send( int16_t pid, msg_t *msg );
+
+/*
+** receive - receive a message from another process
+**
+** usage:	n = receive( &from, &msg );
+**
+** if 'from' is IPC_ANY, takes a message from any process; otherwise,
+** only from that PID.  Blocks until a message arrives.
+**
+** returns:
+**      0 on success (with 'from' set to the sender), or -1 on error
+*/
+
+int receive( int16_t *from, msg_t *buf );
+
 /*
 ** bogus - a bogus system call, for testing our syscall ISR
 **
@@ -67,6 +67,8 @@
 // no user U
 // no user V
 #define SPAWN_NET
+//#define	SPAWN_PROF	//  X    .    X    X    X    .    .    (needs PROFILE)
+//#define	SPAWN_DMESG	//  X    .    .    X    X    .    .
 
 /*
 ** Users W-Z are spawned from other processes; they
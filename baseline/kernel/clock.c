@@ -22,11 +22,29 @@
 #include "scheduler.h"
 #include "sio.h"
 #include "syscall.h"
+#include "defer.h"
+#include "ktimer.h"
+#include "profile.h"
 
 /*
 ** PRIVATE DEFINITIONS
 */
 
+// the speaker/timer 2 gate control port
+
+#define	PIT_GATE_PORT		0x61
+#define	PIT_GATE_2		0x01	// timer 2 gate
+#define	PIT_SPEAKER		0x02	// speaker data enable
+#define	PIT_OUT_2		0x20	// timer 2 output (read-only)
+
+// length of the TSC calibration interval, in milliseconds
+
+#define	CALIBRATE_MS		10
+
+// how often the console screen is brought up to date
+
+#define	CONSOLE_FLUSH_TICKS	MS_TO_TICKS(20)
+
 /*
 ** PRIVATE DATA TYPES
 */
@@ -40,6 +58,27 @@
 static uint32_t _pinwheel;	// pinwheel counter
 static uint32_t _pindex;	// index into pinwheel string
 
+static void _clock_pinwheel( void *arg );
+static defer_t _pinwheel_work = DEFER_INIT( _clock_pinwheel, NULL );
+
+static void _clock_console( void *arg );
+static defer_t _console_work = DEFER_INIT( _clock_console, NULL );
+
+#ifdef DUMP_QUEUES
+static void _clock_dump( void *arg );
+static defer_t _dump_work = DEFER_INIT( _clock_dump, NULL );
+#endif
+
+// TSC interpolation
+
+static uint32_t _tsc_per_tick;	// TSC cycles per clock tick (0 if unknown)
+static uint64_t _tsc_at_tick;	// TSC value at the most recent tick
+static uint64_t _tsc_at_boot;	// TSC value at system time 0
+
+// sleeper wakeups are done in batches at this time
+
+static uint32_t _sleep_deadline;
+
 /*
 ** PUBLIC GLOBAL VARIABLES
 */
@@ -50,13 +89,118 @@ uint32_t _system_time;		// the current system time
 ** PRIVATE FUNCTIONS
 */
 
+/*
+** _clock_calibrate()
+**
+** measure the TSC rate by counting cycles across a known interval
+** timed by PIT timer 2
+*/
+
+static void _clock_calibrate( void ) {
+	uint32_t count = (TIMER_FREQUENCY / 1000) * CALIBRATE_MS;
+	uint64_t start, end;
+	uint8_t gate;
+
+	// enable the timer 2 gate, but keep the speaker quiet
+
+	gate = __inb( PIT_GATE_PORT );
+	__outb( PIT_GATE_PORT, (gate & ~PIT_SPEAKER) | PIT_GATE_2 );
+
+	// one-shot countdown; OUT goes high at terminal count
+
+	__outb( TIMER_CONTROL_PORT, TIMER_2_SELECT | TIMER_2_READ | TIMER_MODE_0 );
+	__outb( TIMER_2_PORT, count & 0xff );
+	start = _rdtsc();
+	__outb( TIMER_2_PORT, (count >> 8) & 0xff );
+
+	while( (__inb(PIT_GATE_PORT) & PIT_OUT_2) == 0 ) {
+		continue;
+	}
+
+	end = _rdtsc();
+
+	__outb( PIT_GATE_PORT, gate );
+
+	_tsc_per_tick = ((uint32_t) (end - start)) /
+			(CALIBRATE_MS * CLOCK_FREQUENCY / 1000);
+}
+
+
+/*
+** _clock_pinwheel(arg)
+**
+** deferred work:  spin the pinwheel
+*/
+
+static void _clock_pinwheel( void *arg ) {
+	(void)(arg);
+
+	c_putchar_at( 79, 0, "|/-\\"[ _pindex & 3 ] );
+}
+
+/*
+** _clock_console(arg)
+**
+** deferred work:  copy the console output to the screen
+*/
+
+static void _clock_console( void *arg ) {
+	(void)(arg);
+
+	c_flush();
+}
+
+#ifdef DUMP_QUEUES
+/*
+** _clock_dump(arg)
+**
+** deferred work:  dump the queues and the SIO buffers
+*/
+
+static void _clock_dump( void *arg ) {
+	(void)(arg);
+
+	c_printf( "Queue contents @%08x\n", _system_time );
+	_queue_dump( "ready[0]", _ready[0] );
+	_queue_dump( "ready[1]", _ready[1] );
+	_queue_dump( "ready[2]", _ready[2] );
+	_queue_dump( "ready[3]", _ready[3] );
+	_queue_dump( "sleep", _sleeping );
+	_sio_dump();
+}
+#endif
+
+/*
+** _clock_deadline()
+**
+** find the time of the next batch of wakeups:  the earliest time
+** by which some sleeper's slack runs out
+*/
+
+static uint32_t _clock_deadline( void ) {
+	uint32_t deadline = _system_time + SLACK_MAX + 1;
+	uint32_t latest;
+
+	for( int i = 0; i < N_PCBS; ++i ) {
+		pcb_t *pcb = &_pcbs[i];
+
+		if( pcb->state == STATE_SLEEPING ) {
+			latest = pcb->wakeup + pcb->slack;
+			if( (int32_t) (latest - deadline) < 0 ) {
+				deadline = latest;
+			}
+		}
+	}
+
+	return( deadline );
+}
 
 /*
 ** _clock_isr(vector,code)
 **
 ** Interrupt handler for the clock module.  Spins the pinwheel,
-** wakes up sleeping processes, and handles quantum expiration
-** for the current process.
+** schedules console screen updates, wakes up sleeping processes,
+** and handles quantum expiration for the current process.
 */
 
 static void _clock_isr( int vector, int code ) {
@@ -65,42 +209,73 @@ static void _clock_isr( int vector, int code ) {
 
 	pcb_t *pcb;
 
+#ifdef PROFILE
+	// see where the current process was
+
+	_prof_sample();
+#endif
+
 	// spin the pinwheel
 
 	++_pinwheel;
 	if( _pinwheel == (CLOCK_FREQUENCY / 10) ) {
 		_pinwheel = 0;
 		++_pindex;
-		c_putchar_at( 79, 0, "|/-\\"[ _pindex & 3 ] );
+		_defer( &_pinwheel_work );
 	}
 
-	// increment the system time
+	// update the screen, if anything was printed
+
+	if( (_system_time % CONSOLE_FLUSH_TICKS) == 0 && c_flush_needed() ) {
+		_defer( &_console_work );
+	}
+
+	// increment the system time, and note where the TSC was
 
 	++_system_time;
+	_tsc_at_tick = _rdtsc();
+
+	// let the kernel timers know
+
+	_ktimer_tick();
 
 	/*
-	** wake up any sleeper whose time has come
+	** wake up sleepers in batches:  nothing is done until some
+	** sleeper's slack runs out, and then every sleeper whose
+	** wakeup time has passed is awakened
 	**
 	** we give awakened processes preference over the
 	** current process (when it is scheduled again)
 	*/
 
-	while( !_queue_empty(_sleeping) &&
-	       (uint32_t) _queue_kpeek(_sleeping) <= _system_time ) {
+	if( !_queue_empty(_sleeping) &&
+	    (int32_t) (_system_time - _sleep_deadline) >= 0 ) {
 
-		// time to wake up!  remove it from the queue
-		pcb = (pcb_t *) _queue_remove( _sleeping );
-		if( pcb == NULL ) {
+		while( !_queue_empty(_sleeping) &&
+		       (uint32_t) _queue_kpeek(_sleeping) <= _system_time ) {
+
+			// time to wake up!  remove it from the queue
+			pcb = (pcb_t *) _queue_remove( _sleeping );
+			if( pcb == NULL ) {
 #ifdef DEBUG
-			_kpanic( "_clock_isr", "NULL from sleep queue remove" );
+				_kpanic( "_clock_isr", "NULL from sleep queue remove" );
 #else
-			c_puts( "*** _clock_isr: NULL from sleep queue\n" );
-			break;
+				c_puts( "*** _clock_isr: NULL from sleep queue\n" );
+				break;
 #endif
+			}
+
+			// a poll() which times out is no longer waiting
+
+			pcb->poll_wait = 0;
+
+			// and schedule it for dispatch
+			_schedule( pcb );
 		}
 
-		// and schedule it for dispatch
-		_schedule( pcb );
+		// find the time of the next batch
+
+		_sleep_deadline = _clock_deadline();
 	}
 
 	// check the current process to see if it needs to be scheduled
@@ -118,13 +293,7 @@ static void _clock_isr( int vector, int code ) {
 	// print the contents of the SIO buffers.
 
 	if( (_system_time % SECONDS_TO_TICKS(10)) == 0 ) {
-		c_printf( "Queue contents @%08x\n", _system_time );
-		_queue_dump( "ready[0]", _ready[0] );
-		_queue_dump( "ready[1]", _ready[1] );
-		_queue_dump( "ready[2]", _ready[2] );
-		_queue_dump( "ready[3]", _ready[3] );
-		_queue_dump( "sleep", _sleeping );
-		_sio_dump();
+		_defer( &_dump_work );
 	}
 #endif
 
@@ -155,6 +324,11 @@ void _clock_modinit( void ) {
 
 	_system_time = 0;
 
+	// find out how fast the TSC runs (before the clock starts)
+
+	_clock_calibrate();
+	_tsc_at_tick = _tsc_at_boot = _rdtsc();
+
 	// set the clock to tick at CLOCK_FREQUENCY Hz.
 
 	divisor = TIMER_FREQUENCY / CLOCK_FREQUENCY;
@@ -170,3 +344,83 @@ void _clock_modinit( void ) {
 
         c_puts( " CLOCK" );
 }
+
+/*
+** _clock_ns()
+**
+** returns the monotonic time since boot, in nanoseconds
+**
+** The time at the last tick is advanced by the TSC cycles elapsed
+** since then.  The advance is capped just short of one tick, so the
+** result never passes the time of the next tick even if that tick's
+** interrupt is late; thus the clock is monotonic.
+**
+** Must be called with interrupts disabled.
+*/
+
+uint64_t _clock_ns( void ) {
+	uint64_t ns = (uint64_t) _system_time * NS_PER_TICK;
+	uint64_t delta;
+
+	if( _tsc_per_tick != 0 ) {
+		delta = _rdtsc() - _tsc_at_tick;
+		if( delta >= _tsc_per_tick ) {
+			delta = _tsc_per_tick - 1;
+		}
+		ns += _muldiv( (uint32_t) delta, NS_PER_TICK, _tsc_per_tick );
+	}
+
+	return( ns );
+}
+
+/*
+** _clock_tsc_ns(tsc)
+**
+** returns the time since boot, in nanoseconds, at which the TSC
+** read 'tsc' (0 for times before the clock was started)
+**
+** This uses the calibrated TSC rate throughout, so it can drift
+** slightly from the tick count over a long time.
+*/
+
+uint64_t _clock_tsc_ns( uint64_t tsc ) {
+	uint64_t cycles;
+	uint32_t ticks;
+
+	if( _tsc_per_tick == 0 || tsc < _tsc_at_boot ) {
+		return( 0 );
+	}
+
+	cycles = tsc - _tsc_at_boot;
+	ticks = _udiv64( cycles, _tsc_per_tick );
+	cycles -= (uint64_t) ticks * _tsc_per_tick;
+
+	return( (uint64_t) ticks * NS_PER_TICK +
+		_muldiv( (uint32_t) cycles, NS_PER_TICK, _tsc_per_tick ) );
+}
+
+/*
+** _clock_sleep(pcb,ticks)
+**
+** put 'pcb' on the sleep queue for 'ticks' clock ticks
+**
+** The process will be awakened in the first batch of wakeups at or
+** after its wakeup time, which is no more than pcb->slack ticks late.
+*/
+
+void _clock_sleep( pcb_t *pcb, uint32_t ticks ) {
+	uint32_t latest;
+
+	pcb->wakeup = _system_time + ticks;
+	pcb->state = STATE_SLEEPING;
+
+	// the next batch may have to come sooner
+
+	latest = pcb->wakeup + pcb->slack;
+	if( _queue_empty(_sleeping) ||
+	    (int32_t) (latest - _sleep_deadline) < 0 ) {
+		_sleep_deadline = latest;
+	}
+
+	_queue_insert( _sleeping, (void *)pcb, (void *) pcb->wakeup );
+}
@@ -0,0 +1,180 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	defer.c
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Deferred work implementation
+**
+** Queued work items form a FIFO list.  The deferred work process
+** takes items from the list with interrupts disabled and runs them
+** with interrupts enabled.  When the list is empty, it sleeps; the
+** interrupts are still disabled when the sleep() system call is
+** made, so an item queued by an ISR can't slip in between the check
+** and the sleep.  _defer() wakes the process early if it is asleep.
+**
+** As the work process runs at PRIO_SYSTEM, _defer() also asks for
+** a lower-priority current process to be preempted, so that the work
+** is done as soon as the ISR returns.  The switch itself is left to
+** the ISR exit code (see _resched()); switching here would take the
+** CPU away in the middle of the ISR or system call which queued the
+** work.
+*/
+
+#define	__SP_KERNEL__
+
+#include "common.h"
+
+#include "defer.h"
+#include "process.h"
+#include "queue.h"
+#include "scheduler.h"
+#include "syscall.h"
+
+// need the sleep_slack() prototype
+#include "ulib.h"
+
+/*
+** PRIVATE DEFINITIONS
+*/
+
+// how long the work process sleeps when idle (it will normally be
+// awakened long before this by _defer()); its timeout is never urgent,
+// so it can be late by as much again
+
+#define	DEFER_IDLE_MS		1000
+
+/*
+** PRIVATE DATA TYPES
+*/
+
+/*
+** PRIVATE GLOBAL VARIABLES
+*/
+
+static defer_t *_defer_head;	// first queued item
+static defer_t *_defer_tail;	// last queued item
+static pcb_t *_defer_pcb;	// the deferred work process
+
+/*
+** PUBLIC GLOBAL VARIABLES
+*/
+
+/*
+** PRIVATE FUNCTIONS
+*/
+
+/*
+** _defer_worker()
+**
+** main routine of the deferred work process
+*/
+
+static void _defer_worker( void ) {
+	defer_t *work;
+	uint32_t flags;
+
+	for(;;) {
+
+		flags = _int_disable();
+
+		work = _defer_head;
+		if( work == NULL ) {
+			sleep_slack( DEFER_IDLE_MS, DEFER_IDLE_MS );
+			_int_restore( flags );
+			continue;
+		}
+
+		_defer_head = work->next;
+		if( _defer_head == NULL ) {
+			_defer_tail = NULL;
+		}
+		work->next = NULL;
+		work->queued = 0;
+
+		_int_restore( flags );
+
+		// do the work with interrupts enabled
+
+		work->func( work->arg );
+	}
+}
+
+/*
+** PUBLIC FUNCTIONS
+*/
+
+/*
+** _defer_modinit()
+**
+** initialize the deferred work module
+*/
+
+void _defer_modinit( void ) {
+
+	_defer_head = _defer_tail = NULL;
+	_defer_pcb = NULL;
+
+	c_puts( " DEFER" );
+}
+
+/*
+** _defer_start()
+**
+** create the deferred work process
+*/
+
+void _defer_start( void ) {
+
+	_defer_pcb = _create_process( (uint32_t) _defer_worker, PRIO_SYSTEM );
+	if( _defer_pcb == NULL ) {
+		_kpanic( "_defer_start", "deferred work process creation failed" );
+	}
+
+	_schedule( _defer_pcb );
+}
+
+/*
+** _defer(work)
+**
+** queue a work item to be run by the deferred work process
+**
+** must be called with interrupts disabled (normally, from an ISR)
+*/
+
+void _defer( defer_t *work ) {
+
+	if( work->queued ) {
+		return;
+	}
+
+	work->queued = 1;
+	work->next = NULL;
+	if( _defer_tail == NULL ) {
+		_defer_head = work;
+	} else {
+		_defer_tail->next = work;
+	}
+	_defer_tail = work;
+
+	// work queued before the process exists will be found when it starts
+
+	if( _defer_pcb == NULL ) {
+		return;
+	}
+
+	// wake the work process if it is idle
+
+	if( _defer_pcb->state == STATE_SLEEPING ) {
+		_queue_delete( _sleeping, (void *) _defer_pcb );
+		_schedule( _defer_pcb );
+	}
+
+	// and let it run ahead of the interrupted process once the
+	// ISR is done
+
+	_need_resched = 1;
+}
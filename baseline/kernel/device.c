@@ -0,0 +1,401 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	device.c
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Device switch implementation
+**
+** The switch is a table of device pointers indexed by device number.
+** Each process' descriptor table holds device numbers, so a child's
+** table is just a copy of its parent's.
+**
+** The console devices (one per virtual console, with the console
+** number as their private data) are registered here; other drivers
+** register their own devices from their module initialization
+** routines, which must run before the first process is created.
+**
+** A process blocked in poll() is marked by its 'poll_wait' flag; if
+** it gave a timeout, it is also on the sleep queue.  Whichever comes
+** first (a notification which satisfies it, or the clock) wakes it
+** and clears the flag.  There are few enough PCBs that notifications
+** simply check all of them.
+*/
+
+#define	__SP_KERNEL__
+
+#include "common.h"
+
+#include "device.h"
+#include "process.h"
+#include "queue.h"
+#include "scheduler.h"
+#include "syscall.h"
+
+#include "startup.h"
+#include <x86arch.h>
+
+/*
+** PRIVATE DEFINITIONS
+*/
+
+/*
+** PRIVATE DATA TYPES
+*/
+
+/*
+** PRIVATE GLOBAL VARIABLES
+*/
+
+static device_t *_devices[ N_DEVICES ];	// the device switch
+
+static int _con_read( device_t *dev, char *buf, int count );
+static int _con_write( device_t *dev, char *buf, int count );
+static int _con_poll( device_t *dev );
+
+static device_t _consoles[ C_CONSOLES ];
+
+static char *_con_names[] = {
+	"console", "console1", "console2", "console3", "console4",
+	"console5", "console6", "console7", "console8", "console9"
+};
+
+	// the console library's keyboard ISR
+static void (*_con_kbd_isr)( int vector, int code );
+
+/*
+** PUBLIC GLOBAL VARIABLES
+*/
+
+/*
+** PRIVATE FUNCTIONS
+*/
+
+/*
+** _con_read(dev,buf,count)
+**
+** console read operation:  take whatever keystrokes are queued
+*/
+
+static int _con_read( device_t *dev, char *buf, int count ) {
+
+	return( c_vc_getbuf((uint32_t) dev->data,buf,count) );
+}
+
+/*
+** _con_write(dev,buf,count)
+**
+** console write operation
+*/
+
+static int _con_write( device_t *dev, char *buf, int count ) {
+
+	c_vc_putbuf( (uint32_t) dev->data, buf, count );
+
+	return( count );
+}
+
+/*
+** _con_poll(dev)
+**
+** console poll operation
+*/
+
+static int _con_poll( device_t *dev ) {
+	uint32_t vc = (uint32_t) dev->data;
+
+	return( (c_vc_input_queue(vc) > 0 ? POLLIN : 0) | POLLOUT );
+}
+
+/*
+** _con_isr(vector,code)
+**
+** keyboard ISR:  let the console library collect the keystroke,
+** then tell any pollers of the console it went to about it
+*/
+
+static void _con_isr( int vector, int code ) {
+
+	_con_kbd_isr( vector, code );
+
+	_dev_notify( &_consoles[ c_vc_shown() ] );
+}
+
+/*
+** _dev_scan(pcb,dev)
+**
+** check the poll() request of 'pcb', filling in the 'revents' fields
+**
+** if 'dev' is non-NULL, the request is only checked if it includes
+** that device
+**
+** returns the number of ready descriptors
+*/
+
+static int _dev_scan( pcb_t *pcb, device_t *dev ) {
+	pollfd_t *fds = (pollfd_t *) ARG(1,pcb->context);
+	int nfds = (int) ARG(2,pcb->context);
+	device_t *which;
+	int ready = 0;
+	int i;
+
+	if( dev != NULL ) {
+		for( i = 0; i < nfds; ++i ) {
+			if( _dev_lookup(pcb,fds[i].fd) == dev ) {
+				break;
+			}
+		}
+		if( i >= nfds ) {
+			return( 0 );
+		}
+	}
+
+	for( i = 0; i < nfds; ++i ) {
+
+		which = _dev_lookup( pcb, fds[i].fd );
+		if( which == NULL ) {
+			fds[i].revents = POLLNVAL;
+		} else if( which->poll == NULL ) {
+			fds[i].revents = 0;
+		} else {
+			fds[i].revents = which->poll(which) & fds[i].events;
+		}
+
+		if( fds[i].revents != 0 ) {
+			++ready;
+		}
+	}
+
+	return( ready );
+}
+
+/*
+** PUBLIC FUNCTIONS
+*/
+
+/*
+** _dev_modinit()
+**
+** initialize the device switch, and register the consoles
+*/
+
+void _dev_modinit( void ) {
+
+	for( int i = 0; i < N_DEVICES; ++i ) {
+		_devices[i] = NULL;
+	}
+
+	for( int vc = 0; vc < C_CONSOLES; ++vc ) {
+		_consoles[vc].name = _con_names[vc];
+		_consoles[vc].read = _con_read;
+		_consoles[vc].write = _con_write;
+		_consoles[vc].poll = _con_poll;
+		_consoles[vc].ioctl = NULL;
+		_consoles[vc].data = (void *) vc;
+		_dev_register( DEV_VC(vc), &_consoles[vc] );
+	}
+
+	// hook into the keyboard ISR (c_io_init() must have been called)
+
+	_con_kbd_isr = __install_isr( INT_VEC_KEYBOARD, _con_isr );
+
+	c_puts( " DEV" );
+}
+
+/*
+** _dev_register(num,dev)
+**
+** register 'dev' as device number 'num'
+**
+** returns the device number, or -1 if it is already in use
+*/
+
+int _dev_register( int num, device_t *dev ) {
+
+	if( num < 0 || num >= N_DEVICES || _devices[num] != NULL ) {
+		return( -1 );
+	}
+
+	_devices[num] = dev;
+
+	return( num );
+}
+
+/*
+** _dev_fd_init(pcb,parent)
+**
+** initialize the descriptor table of 'pcb' as a copy of the table
+** of 'parent', or as the initial table if 'parent' is NULL
+*/
+
+void _dev_fd_init( pcb_t *pcb, pcb_t *parent ) {
+
+	for( int fd = 0; fd < N_FDS; ++fd ) {
+
+		if( parent != NULL ) {
+			pcb->fds[fd] = parent->fds[fd];
+		} else if( fd < N_DEVICES && _devices[fd] != NULL ) {
+			pcb->fds[fd] = fd;
+		} else {
+			pcb->fds[fd] = DEV_NONE;
+		}
+
+	}
+}
+
+/*
+** _dev_lookup(pcb,fd)
+**
+** returns the device open on descriptor 'fd' of 'pcb', or NULL
+*/
+
+device_t *_dev_lookup( pcb_t *pcb, int fd ) {
+
+	if( fd < 0 || fd >= N_FDS || pcb->fds[fd] == DEV_NONE ) {
+		return( NULL );
+	}
+
+	return( _devices[ pcb->fds[fd] ] );
+}
+
+/*
+** _dev_read(pcb,fd,buf,count)
+**
+** read up to 'count' bytes from descriptor 'fd' into 'buf'
+**
+** returns the number of bytes read, or -1 on error
+*/
+
+int _dev_read( pcb_t *pcb, int fd, char *buf, int count ) {
+	device_t *dev = _dev_lookup( pcb, fd );
+
+	if( dev == NULL || dev->read == NULL || count < 0 ) {
+		return( -1 );
+	}
+
+	if( count == 0 ) {
+		return( 0 );
+	}
+
+	return( dev->read(dev,buf,count) );
+}
+
+/*
+** _dev_write(pcb,fd,buf,count)
+**
+** write 'count' bytes from 'buf' to descriptor 'fd'; if 'count'
+** is 0, 'buf' is a NUL-terminated string
+**
+** returns the number of bytes written, or -1 on error
+*/
+
+int _dev_write( pcb_t *pcb, int fd, char *buf, int count ) {
+	device_t *dev = _dev_lookup( pcb, fd );
+
+	if( dev == NULL || dev->write == NULL || count < 0 ) {
+		return( -1 );
+	}
+
+	if( count == 0 ) {
+		while( buf[count] != '\0' ) {
+			++count;
+		}
+		if( count == 0 ) {
+			return( 0 );
+		}
+	}
+
+	return( dev->write(dev,buf,count) );
+}
+
+/*
+** _dev_ioctl(pcb,fd,request,arg)
+**
+** perform a control request on descriptor 'fd'
+**
+** returns the device's result, or -1 on error
+*/
+
+int _dev_ioctl( pcb_t *pcb, int fd, int request, uint32_t arg ) {
+	device_t *dev = _dev_lookup( pcb, fd );
+
+	if( dev == NULL || dev->ioctl == NULL ) {
+		return( -1 );
+	}
+
+	return( dev->ioctl(dev,request,arg) );
+}
+
+/*
+** _dev_poll(pcb)
+**
+** implement the poll() request in the context of 'pcb'
+**
+** the request is in the syscall arguments:  the pollfd_t array, its
+** length, and the timeout in milliseconds
+*/
+
+void _dev_poll( pcb_t *pcb ) {
+	int nfds = (int) ARG(2,pcb->context);
+	int32_t timeout = (int32_t) ARG(3,pcb->context);
+	int ready;
+
+	if( nfds < 0 ) {
+		RET(pcb->context) = -1;
+		return;
+	}
+
+	ready = _dev_scan( pcb, NULL );
+	if( ready > 0 || timeout == 0 ) {
+		RET(pcb->context) = ready;
+		return;
+	}
+
+	// nothing is ready - wait for a notification (or the clock)
+
+	pcb->poll_wait = 1;
+	RET(pcb->context) = 0;
+
+	if( timeout > 0 ) {
+		_clock_sleep( pcb, MS_TO_TICKS(timeout) );
+	} else {
+		pcb->state = STATE_BLOCKED;
+	}
+
+	_dispatch();
+}
+
+/*
+** _dev_notify(dev)
+**
+** called (typically from an ISR) when 'dev' may have become ready;
+** wakes up any process polling it whose request is now satisfied
+*/
+
+void _dev_notify( device_t *dev ) {
+	int ready;
+
+	for( int i = 0; i < N_PCBS; ++i ) {
+		pcb_t *pcb = &_pcbs[i];
+
+		if( !pcb->poll_wait ) {
+			continue;
+		}
+
+		ready = _dev_scan( pcb, dev );
+		if( ready == 0 ) {
+			continue;
+		}
+
+		if( pcb->state == STATE_SLEEPING ) {
+			_queue_delete( _sleeping, (void *) pcb );
+		}
+
+		pcb->poll_wait = 0;
+		RET(pcb->context) = ready;
+		_schedule( pcb );
+	}
+}
@@ -0,0 +1,228 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	ipc.c
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Synchronous message passing implementation
+**
+** Each PCB heads a FIFO list of the processes blocked sending to it,
+** linked through their 'ipc_next' fields.  A blocked receiver is
+** marked IPC_RECEIVING; the PID it will accept a message from is
+** found through the 'from' pointer in its syscall arguments.
+**
+** When a sender finds its receiver already waiting, the message is
+** copied register-to-register and the CPU goes straight to the
+** receiver without a pass through the ready queues.
+*/
+
+#define	__SP_KERNEL__
+
+#include "common.h"
+
+#include "ipc.h"
+#include "page.h"
+#include "process.h"
+#include "scheduler.h"
+
+/*
+** PRIVATE DEFINITIONS
+*/
+
+// the 'from' argument of a process blocked in receive()
+
+#define	IPC_FROM(p)	((int16_t *) ARG(1,(p)->context))
+
+/*
+** PRIVATE DATA TYPES
+*/
+
+/*
+** PRIVATE GLOBAL VARIABLES
+*/
+
+/*
+** PUBLIC GLOBAL VARIABLES
+*/
+
+/*
+** PRIVATE FUNCTIONS
+*/
+
+/*
+** _ipc_accepts(rcv,pid)
+**
+** determine whether a receiver will take a message from 'pid'
+*/
+
+static bool_t _ipc_accepts( pcb_t *rcv, int16_t pid ) {
+	int16_t *from = IPC_FROM( rcv );
+
+	return( from == NULL || *from == IPC_ANY || *from == pid );
+}
+
+/*
+** _ipc_pages_ok(pcb)
+**
+** verify that the sender owns every page it is trying to transfer
+*/
+
+static bool_t _ipc_pages_ok( pcb_t *pcb ) {
+	uint8_t *page = (uint8_t *) pcb->context->esi;
+	uint32_t npages = pcb->context->edi;
+
+	return( npages == 0 || _page_owns(page,npages,pcb->pid) );
+}
+
+/*
+** _ipc_deliver(snd,rcv)
+**
+** move a message from a sender to a receiver, and complete both
+** system calls
+*/
+
+static void _ipc_deliver( pcb_t *snd, pcb_t *rcv ) {
+	context_t *from = snd->context;
+	context_t *to = rcv->context;
+	int16_t *who;
+
+	to->ebx = from->ebx;
+	to->ecx = from->ecx;
+	to->edx = from->edx;
+	to->esi = from->esi;
+	to->edi = from->edi;
+
+	if( from->edi != 0 ) {
+		_page_chown( (void *) from->esi, from->edi, rcv->pid );
+	}
+
+	who = IPC_FROM( rcv );
+	if( who != NULL ) {
+		*who = snd->pid;
+	}
+
+	snd->ipc_wait = IPC_NONE;
+	rcv->ipc_wait = IPC_NONE;
+
+	RET(from) = 0;
+	RET(to) = 0;
+}
+
+/*
+** PUBLIC FUNCTIONS
+*/
+
+/*
+** _ipc_send(pcb)
+**
+** send the message in the context of 'pcb' to the PID given as
+** its first syscall argument
+*/
+
+void _ipc_send( pcb_t *pcb ) {
+	int16_t pid = (int16_t) ARG(1,pcb->context);
+	pcb_t *dst;
+	pcb_t **link;
+
+	dst = _pcb_find( pid );
+	if( dst == NULL || dst == pcb || !_ipc_pages_ok(pcb) ) {
+		RET(pcb->context) = -1;
+		return;
+	}
+
+	// if the receiver is waiting for us, hand the message over
+	// and switch directly to the receiver
+
+	if( dst->ipc_wait == IPC_RECEIVING && _ipc_accepts(dst,pcb->pid) ) {
+		_ipc_deliver( pcb, dst );
+		_schedule( pcb );
+		_dispatch_to( dst );
+		return;
+	}
+
+	// otherwise, get in line behind any other senders
+
+	pcb->ipc_wait = IPC_SENDING;
+	pcb->ipc_next = NULL;
+	for( link = &dst->ipc_senders; *link != NULL; link = &(*link)->ipc_next ) {
+		continue;
+	}
+	*link = pcb;
+
+	pcb->state = STATE_BLOCKED;
+	_dispatch();
+}
+
+/*
+** _ipc_receive(pcb)
+**
+** receive a message into the context of 'pcb'
+*/
+
+void _ipc_receive( pcb_t *pcb ) {
+	int16_t *from = IPC_FROM( pcb );
+	pcb_t **link;
+	pcb_t *snd;
+
+	// take the first acceptable sender, if there is one
+
+	for( link = &pcb->ipc_senders; *link != NULL; link = &(*link)->ipc_next ) {
+		snd = *link;
+		if( _ipc_accepts(pcb,snd->pid) ) {
+			*link = snd->ipc_next;
+			snd->ipc_next = NULL;
+			_ipc_deliver( snd, pcb );
+			_schedule( snd );
+			return;
+		}
+	}
+
+	// nobody yet - don't wait for a process that doesn't exist
+
+	if( from != NULL && *from != IPC_ANY && _pcb_find(*from) == NULL ) {
+		RET(pcb->context) = -1;
+		return;
+	}
+
+	pcb->ipc_wait = IPC_RECEIVING;
+	pcb->state = STATE_BLOCKED;
+	_dispatch();
+}
+
+/*
+** _ipc_release(pcb)
+**
+** clean up IPC state for a process which is exiting
+**
+** Blocked senders and receivers waiting specifically for this
+** process are failed; pages it owns go back to the pool.
+*/
+
+void _ipc_release( pcb_t *pcb ) {
+	pcb_t *snd;
+
+	while( (snd = pcb->ipc_senders) != NULL ) {
+		pcb->ipc_senders = snd->ipc_next;
+		snd->ipc_next = NULL;
+		snd->ipc_wait = IPC_NONE;
+		RET(snd->context) = -1;
+		_schedule( snd );
+	}
+
+	for( int i = 0; i < N_PCBS; ++i ) {
+		pcb_t *rcv = &_pcbs[i];
+
+		if( rcv->state == STATE_BLOCKED &&
+		    rcv->ipc_wait == IPC_RECEIVING &&
+		    IPC_FROM(rcv) != NULL && *IPC_FROM(rcv) == pcb->pid ) {
+			rcv->ipc_wait = IPC_NONE;
+			RET(rcv->context) = -1;
+			_schedule( rcv );
+		}
+	}
+
+	_page_release( pcb->pid );
+}
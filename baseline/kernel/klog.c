@@ -0,0 +1,381 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	klog.c
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Kernel log implementation
+**
+** Records go into a ring of KLOG_RECORDS fixed-size entries, indexed
+** by a free-running record number.  Appending a record takes a slot
+** and fills it in with interrupts disabled for those few stores, so
+** a record is never seen half-written; nothing else ever waits.
+** Readers (the flusher and the log device) copy a record out the
+** same way and format the copy.  A writer never waits for a reader:
+** when the ring wraps, the oldest records are overwritten, and the
+** flusher reports how many it missed.
+**
+** The log device produces one line per record, oldest first:
+**
+**	[seconds.microseconds] L text
+**
+** where L is the severity (E, W, I or D).  As with the profiler, a
+** read() which returns 0 marks the end, and the next read() starts
+** over from the oldest record still in the ring.
+*/
+
+#define	__SP_KERNEL__
+
+#include "common.h"
+
+#include "klog.h"
+
+#include "clock.h"
+#include "defer.h"
+#include "device.h"
+#include "sio.h"
+
+/*
+** PRIVATE DEFINITIONS
+*/
+
+#define	KLOG_MASK	(KLOG_RECORDS - 1)
+
+#if (KLOG_RECORDS & KLOG_MASK) != 0
+#error "KLOG_RECORDS must be a power of two"
+#endif
+
+// longest line produced (longer messages are truncated)
+
+#define	KLOG_LINE	128
+
+/*
+** PRIVATE DATA TYPES
+*/
+
+// one log record
+
+typedef struct klog_rec {
+	uint64_t	tsc;			// when it was logged
+	char		*fmt;			// the message format
+	uint32_t	args[ KLOG_ARGS ];	// and its arguments
+	int		level;			// severity
+} klog_rec_t;
+
+/*
+** PRIVATE GLOBAL VARIABLES
+*/
+
+static klog_rec_t _klog_ring[ KLOG_RECORDS ];
+static volatile uint32_t _klog_head;	// records appended
+static uint32_t _klog_flushed;		// records sent to the sinks
+static uint32_t _klog_next;		// log device position
+static int _klog_dumping;		// log device read under way?
+
+	// sink levels; records at these or more severe are printed
+static int _klog_console = KLOG_CONSOLE_LEVEL;
+static int _klog_serial = KLOG_SERIAL_LEVEL;
+
+	// can records be flushed by deferred work yet?
+static int _klog_ready;
+
+static void _klog_work_func( void *arg );
+static defer_t _klog_work = DEFER_INIT( _klog_work_func, NULL );
+
+static int _klog_read( device_t *dev, char *buf, int count );
+static int _klog_ioctl( device_t *dev, int request, uint32_t arg );
+
+static device_t _klog_device = {
+	"klog", _klog_read, NULL, NULL, _klog_ioctl, NULL
+};
+
+/*
+** PUBLIC GLOBAL VARIABLES
+*/
+
+/*
+** PRIVATE FUNCTIONS
+*/
+
+/*
+** _klog_get(num,rec)
+**
+** copy record number 'num' into 'rec'
+**
+** returns 1 on success, or 0 if the record has been overwritten
+*/
+
+static int _klog_get( uint32_t num, klog_rec_t *rec ) {
+	uint32_t flags;
+	int ok;
+
+	flags = _int_disable();
+
+	ok = (_klog_head - num) <= KLOG_RECORDS;
+	if( ok ) {
+		*rec = _klog_ring[ num & KLOG_MASK ];
+	}
+
+	_int_restore( flags );
+
+	return( ok );
+}
+
+/*
+** _klog_line(line,rec)
+**
+** format 'rec' as a line of the log into 'line' (which must hold
+** KLOG_LINE characters)
+**
+** returns the length of the line
+*/
+
+static int _klog_line( char *line, klog_rec_t *rec ) {
+	uint64_t ns;
+	uint32_t secs, usecs;
+	int n, len;
+
+	ns = _clock_tsc_ns( rec->tsc );
+	secs = _udiv64( ns, 1000000000 );
+	usecs = ((uint32_t) (ns - (uint64_t) secs * 1000000000)) / 1000;
+
+	n = c_snprintf( line, KLOG_LINE, "[%5u.%06u] %c ", secs, usecs,
+			"EWID"[ rec->level & 3 ] );
+
+	// the message, truncated to leave room for the newline
+
+	len = c_vsnprintf( line + n, KLOG_LINE - n, rec->fmt, rec->args );
+	n += len < KLOG_LINE - n ? len : KLOG_LINE - n - 1;
+
+	// each record is exactly one line
+
+	while( n > 0 && line[n - 1] == '\n' ) {
+		--n;
+	}
+	line[n++] = '\n';
+
+	return( n );
+}
+
+/*
+** _klog_emit(rec)
+**
+** print a record on the sinks which want it
+*/
+
+static void _klog_emit( klog_rec_t *rec ) {
+	char line[ KLOG_LINE + 1 ];
+	int len;
+
+	if( rec->level > _klog_console && rec->level > _klog_serial ) {
+		return;
+	}
+
+	len = _klog_line( line, rec );
+	line[len] = '\0';
+
+	if( rec->level <= _klog_console ) {
+		c_puts( line );
+	}
+
+	if( rec->level <= _klog_serial ) {
+		_sio_puts( line );
+	}
+}
+
+/*
+** _klog_work_func(arg)
+**
+** deferred work:  flush the new records
+*/
+
+static void _klog_work_func( void *arg ) {
+	(void)(arg);
+
+	_klog_flush();
+}
+
+/*
+** _klog_read(dev,buf,count)
+**
+** log device read operation:  as many whole lines of the log as fit
+**
+** returns -1 if 'count' can't hold the longest line
+*/
+
+static int _klog_read( device_t *dev, char *buf, int count ) {
+	klog_rec_t rec;
+	char line[ KLOG_LINE ];
+	uint32_t head;
+	int n = 0, len;
+	(void)(dev);
+
+	if( count < KLOG_LINE ) {
+		return( -1 );
+	}
+
+	for(;;) {
+
+		head = _klog_head;
+
+		if( !_klog_dumping ) {
+			_klog_dumping = 1;
+			_klog_next = head > KLOG_RECORDS ? head - KLOG_RECORDS : 0;
+		}
+
+		if( _klog_next == head ) {
+			if( n == 0 ) {
+				// the next read starts over
+				_klog_dumping = 0;
+			}
+			break;
+		}
+
+		if( !_klog_get(_klog_next,&rec) ) {
+			// overwritten while we were reading; skip ahead
+			_klog_next = head - KLOG_RECORDS;
+			continue;
+		}
+
+		len = _klog_line( line, &rec );
+		if( n + len > count ) {
+			break;
+		}
+		for( int i = 0; i < len; ++i ) {
+			buf[n++] = line[i];
+		}
+		++_klog_next;
+	}
+
+	return( n );
+}
+
+/*
+** _klog_ioctl(dev,request,arg)
+**
+** log device control operation:  set a sink level
+**
+** returns the prior level, or -1 on error
+*/
+
+static int _klog_ioctl( device_t *dev, int request, uint32_t arg ) {
+	int level = (int) arg;
+	int old;
+	(void)(dev);
+
+	if( level < KLOG_OFF || level > KLOG_DEBUG ) {
+		return( -1 );
+	}
+
+	switch( request ) {
+
+	case IOC_KLOG_CONSOLE:
+		old = _klog_console;
+		_klog_console = level;
+		break;
+
+	case IOC_KLOG_SERIAL:
+		old = _klog_serial;
+		_klog_serial = level;
+		break;
+
+	default:
+		return( -1 );
+	}
+
+	return( old );
+}
+
+/*
+** PUBLIC FUNCTIONS
+*/
+
+/*
+** _klog_modinit()
+**
+** initialize the kernel log, and register its device
+**
+** Anything logged before this is kept, and flushed with the first
+** record logged afterward.
+*/
+
+void _klog_modinit( void ) {
+
+	_klog_dumping = 0;
+	_klog_ready = 1;
+
+	_dev_register( DEV_KLOG, &_klog_device );
+
+	c_puts( " KLOG" );
+}
+
+/*
+** _klog(level,fmt,...)
+**
+** append a record to the kernel log
+**
+** The argument words are copied from the stack the way c_printf()
+** finds them; words which weren't passed are copied too, and ignored.
+*/
+
+void _klog( int level, char *fmt, ... ) {
+	uint32_t *ap = (uint32_t *) (&fmt + 1);
+	klog_rec_t *rec;
+	uint32_t flags;
+
+	flags = _int_disable();
+
+	rec = &_klog_ring[ _klog_head & KLOG_MASK ];
+	rec->tsc = _rdtsc();
+	rec->fmt = fmt;
+	rec->level = level;
+	for( int i = 0; i < KLOG_ARGS; ++i ) {
+		rec->args[i] = ap[i];
+	}
+	++_klog_head;
+
+	// only wake the flusher if someone will see this
+
+	if( _klog_ready &&
+	    (level <= _klog_console || level <= _klog_serial) ) {
+		_defer( &_klog_work );
+	}
+
+	_int_restore( flags );
+}
+
+/*
+** _klog_flush()
+**
+** send any records not yet printed to the sinks
+*/
+
+void _klog_flush( void ) {
+	klog_rec_t rec;
+	uint32_t lost;
+
+	while( _klog_flushed != _klog_head ) {
+
+		// fell behind?  report it, and go on from the oldest
+
+		lost = _klog_head - _klog_flushed;
+		if( lost > KLOG_RECORDS ) {
+			lost -= KLOG_RECORDS;
+			_klog_flushed += lost;
+			rec.tsc = _rdtsc();
+			rec.fmt = "** klog: %d records lost";
+			rec.args[0] = lost;
+			rec.level = KLOG_WARN;
+			_klog_emit( &rec );
+			continue;
+		}
+
+		if( _klog_get(_klog_flushed,&rec) ) {
+			++_klog_flushed;
+			_klog_emit( &rec );
+		}
+	}
+}
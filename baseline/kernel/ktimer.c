@@ -0,0 +1,244 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	ktimer.c
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Kernel timer implementation
+**
+** Timers live on a hashed timing wheel:  a timer expiring at tick T
+** is on the list for slot (T % KTIMER_SLOTS).  Arming and cancelling
+** are O(1); each tick only looks at one slot, where timers more than
+** one revolution away are skipped until their turn comes around.
+**
+** _ktimer_last is the last tick whose slot has been processed.  When
+** the clock ISR finds nothing to do for the new tick it advances it
+** directly; otherwise, the slots are processed (catching up on any
+** ticks missed) by deferred work, which also runs the callbacks.
+*/
+
+#define	__SP_KERNEL__
+
+#include "common.h"
+
+#include "ktimer.h"
+#include "clock.h"
+#include "defer.h"
+
+/*
+** PRIVATE DEFINITIONS
+*/
+
+#define	KTIMER_MASK	(KTIMER_SLOTS - 1)
+
+// the latest expiry time whose tick number fits in 32 bits; _udiv64()
+// can't produce a larger quotient
+
+#define	KTIMER_MAX_NS	((uint64_t) 0xffffffffU * NS_PER_TICK)
+
+/*
+** PRIVATE DATA TYPES
+*/
+
+/*
+** PRIVATE GLOBAL VARIABLES
+*/
+
+static ktimer_t *_ktimer_wheel[ KTIMER_SLOTS ];	// slot list heads
+static uint32_t _ktimer_last;		// last tick processed
+
+static void _ktimer_run( void *arg );
+static defer_t _ktimer_work = DEFER_INIT( _ktimer_run, NULL );
+
+/*
+** PUBLIC GLOBAL VARIABLES
+*/
+
+/*
+** PRIVATE FUNCTIONS
+*/
+
+/*
+** _ktimer_unlink(timer)
+**
+** remove an armed timer from its wheel slot
+**
+** must be called with interrupts disabled
+*/
+
+static void _ktimer_unlink( ktimer_t *timer ) {
+
+	if( timer->prev == NULL ) {
+		_ktimer_wheel[ timer->expires & KTIMER_MASK ] = timer->next;
+	} else {
+		timer->prev->next = timer->next;
+	}
+	if( timer->next != NULL ) {
+		timer->next->prev = timer->prev;
+	}
+
+	timer->next = timer->prev = NULL;
+	timer->armed = 0;
+}
+
+/*
+** _ktimer_run(arg)
+**
+** deferred work:  process every slot up to the current tick, and
+** run the callbacks of the timers which have expired
+*/
+
+static void _ktimer_run( void *arg ) {
+	ktimer_t *timer, *next;
+	uint32_t flags, tick;
+	(void)(arg);
+
+	flags = _int_disable();
+
+	while( _ktimer_last != _system_time ) {
+
+		tick = ++_ktimer_last;
+
+		for( timer = _ktimer_wheel[tick & KTIMER_MASK]; timer != NULL;
+		     timer = next ) {
+
+			next = timer->next;
+
+			// still a later revolution for this one?
+
+			if( (int32_t) (timer->expires - tick) > 0 ) {
+				continue;
+			}
+
+			_ktimer_unlink( timer );
+
+			_int_restore( flags );
+			timer->func( timer->arg );
+			flags = _int_disable();
+
+			// the callback may have changed this slot; start over
+
+			next = _ktimer_wheel[ tick & KTIMER_MASK ];
+		}
+	}
+
+	_int_restore( flags );
+}
+
+/*
+** PUBLIC FUNCTIONS
+*/
+
+/*
+** _ktimer_modinit()
+**
+** initialize the kernel timer module
+*/
+
+void _ktimer_modinit( void ) {
+
+	for( int i = 0; i < KTIMER_SLOTS; ++i ) {
+		_ktimer_wheel[i] = NULL;
+	}
+
+	_ktimer_last = _system_time;
+
+	c_puts( " KTIMER" );
+}
+
+/*
+** _ktimer_arm(timer,expires_ns,func,arg)
+**
+** arrange for func(arg) to be called once _clock_ns() reaches
+** 'expires_ns'; an already-armed timer is re-armed
+*/
+
+void _ktimer_arm( ktimer_t *timer, uint64_t expires_ns,
+		  void (*func)(void *), void *arg ) {
+	uint32_t flags, ticks;
+	ktimer_t **head;
+
+	// round up to a whole tick (after clamping, so neither the
+	// rounding nor the division can overflow)
+
+	if( expires_ns > KTIMER_MAX_NS ) {
+		expires_ns = KTIMER_MAX_NS;
+	}
+	ticks = _udiv64( expires_ns + NS_PER_TICK - 1, NS_PER_TICK );
+
+	flags = _int_disable();
+
+	if( timer->armed ) {
+		_ktimer_unlink( timer );
+	}
+
+	// a time which has already been processed goes in the next slot
+
+	if( (int32_t) (ticks - _ktimer_last) <= 0 ) {
+		ticks = _ktimer_last + 1;
+	}
+
+	timer->expires = ticks;
+	timer->func = func;
+	timer->arg = arg;
+	timer->armed = 1;
+
+	head = &_ktimer_wheel[ ticks & KTIMER_MASK ];
+	timer->prev = NULL;
+	timer->next = *head;
+	if( *head != NULL ) {
+		(*head)->prev = timer;
+	}
+	*head = timer;
+
+	_int_restore( flags );
+}
+
+/*
+** _ktimer_cancel(timer)
+**
+** disarm a timer
+**
+** returns 1 if the timer was armed, else 0
+*/
+
+int _ktimer_cancel( ktimer_t *timer ) {
+	uint32_t flags;
+	int armed;
+
+	flags = _int_disable();
+
+	armed = timer->armed;
+	if( armed ) {
+		_ktimer_unlink( timer );
+	}
+
+	_int_restore( flags );
+
+	return( armed );
+}
+
+/*
+** _ktimer_tick()
+**
+** called by the clock ISR after the system time is advanced
+*/
+
+void _ktimer_tick( void ) {
+
+	if( _ktimer_last + 1 == _system_time &&
+	    _ktimer_wheel[_system_time & KTIMER_MASK] == NULL ) {
+
+		// caught up, and nothing in this slot
+
+		_ktimer_last = _system_time;
+
+	} else {
+
+		_defer( &_ktimer_work );
+
+	}
+}
@@ -0,0 +1,256 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	page.c
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Physical page pool implementation
+**
+** The pool is managed with a simple owner map: one entry per page,
+** holding the PID of the owning process, PAGE_OWNER_KERNEL, or
+** PAGE_OWNER_NONE for free pages.  Allocation is first-fit over
+** the map, which is small enough that a linear scan is cheap.
+*/
+
+#define	__SP_KERNEL__
+
+#include "common.h"
+
+#include "page.h"
+#include "bootstrap.h"
+
+/*
+** PRIVATE DEFINITIONS
+*/
+
+// pseudo functions to convert between addresses and page numbers
+
+#define	ADDR_TO_PAGE(a)	((((uint32_t)(a)) - PAGE_POOL_BASE) >> PAGE_SHIFT)
+#define	PAGE_TO_ADDR(n)	((void *) (PAGE_POOL_BASE + ((n) << PAGE_SHIFT)))
+
+/*
+** PRIVATE DATA TYPES
+*/
+
+/*
+** PRIVATE GLOBAL VARIABLES
+*/
+
+static int16_t _page_owners[ PAGE_POOL_MAX_PAGES ];	// owner map
+static uint32_t _page_count;		// # of pages actually in the pool
+
+/*
+** PUBLIC GLOBAL VARIABLES
+*/
+
+/*
+** PRIVATE FUNCTIONS
+*/
+
+/*
+** _page_valid(addr,npages)
+**
+** determine whether or not a page range lies within the pool
+*/
+
+static bool_t _page_valid( void *addr, uint32_t npages ) {
+	uint32_t a = (uint32_t) addr;
+
+	if( a < PAGE_POOL_BASE || (a & (PAGE_SIZE - 1)) != 0 ) {
+		return( 0 );
+	}
+
+	// (written so that a huge 'npages' can't wrap around)
+
+	return( ADDR_TO_PAGE(a) < _page_count &&
+		npages <= _page_count - ADDR_TO_PAGE(a) );
+}
+
+/*
+** PUBLIC FUNCTIONS
+*/
+
+/*
+** _page_modinit()
+**
+** initialize the page pool
+**
+** The pool is limited by the amount of extended memory the BIOS
+** reported to the bootstrap (in KB between 1MB and 16MB).
+*/
+
+void _page_modinit( void ) {
+	uint32_t ext_kb;
+
+	ext_kb = *((uint16_t *) (MMAP_ADDRESS + MMAP_EXT_LO));
+
+	_page_count = (ext_kb * 1024) >> PAGE_SHIFT;
+	if( _page_count > PAGE_POOL_MAX_PAGES ) {
+		_page_count = PAGE_POOL_MAX_PAGES;
+	}
+
+	// every page starts out free
+
+	_memset( (void *) _page_owners, sizeof(_page_owners), 0 );
+
+	c_puts( " PAGE" );
+}
+
+/*
+** _page_alloc(npages,owner)
+**
+** allocate 'npages' physically contiguous pages for 'owner'
+**
+** returns the address of the first page, or NULL on failure
+*/
+
+void *_page_alloc( uint32_t npages, int16_t owner ) {
+	uint32_t start, run;
+
+	if( npages == 0 || npages > _page_count ) {
+		return( NULL );
+	}
+
+	// first-fit search for a long enough run of free pages
+
+	run = 0;
+	for( uint32_t i = 0; i < _page_count; ++i ) {
+
+		if( _page_owners[i] != PAGE_OWNER_NONE ) {
+			run = 0;
+			continue;
+		}
+
+		if( ++run == npages ) {
+			start = i + 1 - npages;
+			for( i = start; i < start + npages; ++i ) {
+				_page_owners[i] = owner;
+			}
+			return( PAGE_TO_ADDR(start) );
+		}
+	}
+
+	return( NULL );
+}
+
+/*
+** _page_free(addr,npages)
+**
+** return 'npages' pages starting at 'addr' to the pool
+*/
+
+void _page_free( void *addr, uint32_t npages ) {
+
+	_page_chown( addr, npages, PAGE_OWNER_NONE );
+}
+
+/*
+** _page_owner(addr)
+**
+** returns the owner of the page containing 'addr', or
+** PAGE_OWNER_NONE if it is free or not in the pool
+*/
+
+int16_t _page_owner( void *addr ) {
+	uint32_t a = ((uint32_t) addr) & ~(PAGE_SIZE - 1);
+
+	if( !_page_valid((void *) a,1) ) {
+		return( PAGE_OWNER_NONE );
+	}
+
+	return( _page_owners[ ADDR_TO_PAGE(a) ] );
+}
+
+/*
+** _page_owns(addr,npages,owner)
+**
+** determine whether 'owner' owns all of a page-aligned range of
+** 'npages' (at least one) pages starting at 'addr'
+*/
+
+bool_t _page_owns( void *addr, uint32_t npages, int16_t owner ) {
+	uint32_t first;
+
+	if( npages == 0 || !_page_valid(addr,npages) ) {
+		return( 0 );
+	}
+
+	first = ADDR_TO_PAGE( (uint32_t) addr );
+	for( uint32_t i = first; i < first + npages; ++i ) {
+		if( _page_owners[i] != owner ) {
+			return( 0 );
+		}
+	}
+
+	return( 1 );
+}
+
+/*
+** _page_chown(addr,npages,owner)
+**
+** give 'npages' pages starting at 'addr' to a new owner
+*/
+
+void _page_chown( void *addr, uint32_t npages, int16_t owner ) {
+	uint32_t first;
+
+	if( !_page_valid(addr,npages) ) {
+#ifdef DEBUG
+		_kpanic( "_page_chown", "page range not in pool" );
+#endif
+		return;
+	}
+
+	first = ADDR_TO_PAGE(addr);
+	for( uint32_t i = first; i < first + npages; ++i ) {
+		_page_owners[i] = owner;
+	}
+}
+
+/*
+** _page_claim(addr,npages,owner)
+**
+** give 'npages' pages starting at 'addr' to 'owner' if they are
+** all free
+**
+** returns 1 on success, else 0
+*/
+
+bool_t _page_claim( void *addr, uint32_t npages, int16_t owner ) {
+	uint32_t first;
+
+	if( !_page_valid(addr,npages) ) {
+		return( 0 );
+	}
+
+	first = ADDR_TO_PAGE(addr);
+	for( uint32_t i = first; i < first + npages; ++i ) {
+		if( _page_owners[i] != PAGE_OWNER_NONE ) {
+			return( 0 );
+		}
+	}
+
+	for( uint32_t i = first; i < first + npages; ++i ) {
+		_page_owners[i] = owner;
+	}
+
+	return( 1 );
+}
+
+/*
+** _page_release(owner)
+**
+** return every page belonging to 'owner' to the pool
+*/
+
+void _page_release( int16_t owner ) {
+
+	for( uint32_t i = 0; i < _page_count; ++i ) {
+		if( _page_owners[i] == owner ) {
+			_page_owners[i] = PAGE_OWNER_NONE;
+		}
+	}
+}
@@ -0,0 +1,389 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	profile.c
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Sampling profiler implementation
+**
+** Each sample counts the interrupted EIP in a histogram over the
+** kernel text (everything, user code included, is linked into one
+** image) and against the PID of the interrupted process.  The most
+** recent samples are also kept in a ring along with the return
+** addresses found by following the saved %ebp chain on the process'
+** stack, which is enough to build folded stacks for flame graphs.
+**
+** Code which runs with interrupts disabled (ISRs and system calls)
+** can't be interrupted by the clock, so its cost shows up against
+** whatever was running when it was entered.  Deferred work runs with
+** interrupts enabled in the worker process, so it is sampled normally.
+**
+** The profiler device produces a text dump, one record per line,
+** with all numbers in hex:
+**
+**	T begtext etext shift hz	text range and histogram shift
+**	N total other			sample counts (other:  outside text)
+**	P pid count			samples per PID
+**	B addr count			non-empty histogram buckets
+**	S pid eip ret ...		a recent sample and its callers
+**	E				end of the dump
+**
+** The dump is produced a whole line at a time; a read() which
+** returns 0 marks the end, and the next read() starts a new dump.
+*/
+
+#define	__SP_KERNEL__
+
+#include "common.h"
+
+#include "profile.h"
+
+#ifdef PROFILE
+
+#include "clock.h"
+#include "device.h"
+#include "process.h"
+#include "scheduler.h"
+
+/*
+** PRIVATE DEFINITIONS
+*/
+
+// longest line in a dump
+
+#define	PROF_LINE	(4 + 9 * (PROF_DEPTH + 2))
+
+// dump phases
+
+#define	PHASE_HEADER	0
+#define	PHASE_PIDS	1
+#define	PHASE_BUCKETS	2
+#define	PHASE_RING	3
+#define	PHASE_END	4
+#define	PHASE_DONE	5
+
+/*
+** PRIVATE DATA TYPES
+*/
+
+// a PID and its sample count
+
+typedef struct prof_pid {
+	uint32_t	count;
+	int16_t		pid;
+} prof_pid_t;
+
+// a sample with its call chain; pc[0] is the interrupted EIP,
+// followed by return addresses (innermost first), ending with 0
+
+typedef struct prof_sample {
+	uint32_t	pc[ PROF_DEPTH + 1 ];
+	int16_t		pid;
+} prof_sample_t;
+
+/*
+** PRIVATE GLOBAL VARIABLES
+*/
+
+	// limits of the kernel text, from the linker
+extern char begtext[], etext[];
+
+static uint32_t _prof_buckets[ PROF_BUCKETS ];	// EIP histogram
+static prof_pid_t _prof_pids[ PROF_PIDS ];	// per-PID counts
+static prof_sample_t _prof_ring[ PROF_RING ];	// recent samples
+static uint32_t _prof_next;		// total samples taken
+static uint32_t _prof_other;		// samples outside the histogram
+
+static uint32_t _prof_phase;		// dump position
+static uint32_t _prof_index;
+
+static int _prof_read( device_t *dev, char *buf, int count );
+
+static device_t _prof_device = {
+	"prof", _prof_read, NULL, NULL, NULL, NULL
+};
+
+/*
+** PUBLIC GLOBAL VARIABLES
+*/
+
+/*
+** PRIVATE FUNCTIONS
+*/
+
+/*
+** _prof_hex(buf,value)
+**
+** append ' ' and 'value' in hex (without leading zeroes) to 'buf'
+**
+** returns the number of characters stored
+*/
+
+static int _prof_hex( char *buf, uint32_t value ) {
+	int n = 0;
+	int shift = 28;
+
+	buf[n++] = ' ';
+
+	while( shift > 0 && ((value >> shift) & 0xf) == 0 ) {
+		shift -= 4;
+	}
+
+	for( ; shift >= 0; shift -= 4 ) {
+		buf[n++] = "0123456789abcdef"[ (value >> shift) & 0xf ];
+	}
+
+	return( n );
+}
+
+/*
+** _prof_line(line)
+**
+** format the next line of the dump into 'line', advancing the
+** dump position
+**
+** returns the length of the line, or 0 at the end of the dump
+*/
+
+static int _prof_line( char *line ) {
+	prof_sample_t *sample;
+	uint32_t first;
+	int n = 0;
+
+	// skip empty entries
+
+	if( _prof_phase == PHASE_PIDS ) {
+		while( _prof_index < PROF_PIDS &&
+		       _prof_pids[_prof_index].count == 0 ) {
+			++_prof_index;
+		}
+		if( _prof_index >= PROF_PIDS ) {
+			_prof_phase = PHASE_BUCKETS;
+			_prof_index = 0;
+		}
+	}
+
+	if( _prof_phase == PHASE_BUCKETS ) {
+		while( _prof_index < PROF_BUCKETS &&
+		       _prof_buckets[_prof_index] == 0 ) {
+			++_prof_index;
+		}
+		if( _prof_index >= PROF_BUCKETS ) {
+			_prof_phase = PHASE_RING;
+			_prof_index = 0;
+		}
+	}
+
+	if( _prof_phase == PHASE_RING ) {
+		if( _prof_index >= PROF_RING || _prof_index >= _prof_next ) {
+			_prof_phase = PHASE_END;
+		}
+	}
+
+	switch( _prof_phase ) {
+
+	case PHASE_HEADER:
+		line[n++] = 'T';
+		n += _prof_hex( line + n, (uint32_t) begtext );
+		n += _prof_hex( line + n, (uint32_t) etext );
+		n += _prof_hex( line + n, PROF_SHIFT );
+		n += _prof_hex( line + n, CLOCK_FREQUENCY );
+		line[n++] = '\n';
+		line[n++] = 'N';
+		n += _prof_hex( line + n, _prof_next );
+		n += _prof_hex( line + n, _prof_other );
+		_prof_phase = PHASE_PIDS;
+		_prof_index = 0;
+		break;
+
+	case PHASE_PIDS:
+		line[n++] = 'P';
+		n += _prof_hex( line + n, _prof_pids[_prof_index].pid );
+		n += _prof_hex( line + n, _prof_pids[_prof_index].count );
+		++_prof_index;
+		break;
+
+	case PHASE_BUCKETS:
+		line[n++] = 'B';
+		n += _prof_hex( line + n, (uint32_t) begtext +
+				(_prof_index << PROF_SHIFT) );
+		n += _prof_hex( line + n, _prof_buckets[_prof_index] );
+		++_prof_index;
+		break;
+
+	case PHASE_RING:
+		// oldest first
+		first = _prof_next > PROF_RING ? _prof_next - PROF_RING : 0;
+		sample = &_prof_ring[ (first + _prof_index) % PROF_RING ];
+		line[n++] = 'S';
+		n += _prof_hex( line + n, sample->pid );
+		for( int i = 0; i <= PROF_DEPTH && sample->pc[i] != 0; ++i ) {
+			n += _prof_hex( line + n, sample->pc[i] );
+		}
+		++_prof_index;
+		break;
+
+	case PHASE_END:
+		line[n++] = 'E';
+		_prof_phase = PHASE_DONE;
+		break;
+
+	default:
+		// the next read starts over
+		_prof_phase = PHASE_HEADER;
+		return( 0 );
+	}
+
+	line[n++] = '\n';
+
+	return( n );
+}
+
+/*
+** _prof_read(dev,buf,count)
+**
+** profiler read operation:  as many whole lines of the dump as fit
+**
+** returns -1 if 'count' can't hold the longest line
+*/
+
+static int _prof_read( device_t *dev, char *buf, int count ) {
+	static char line[ 2 * PROF_LINE ];
+	static int len = 0;	// pending line which didn't fit
+	int n = 0;
+	(void)(dev);
+
+	if( count < (int) sizeof(line) ) {
+		return( -1 );
+	}
+
+	for(;;) {
+		if( len == 0 ) {
+			len = _prof_line( line );
+			if( len == 0 ) {
+				break;
+			}
+		}
+		if( n + len > count ) {
+			break;
+		}
+		for( int i = 0; i < len; ++i ) {
+			buf[n++] = line[i];
+		}
+		len = 0;
+	}
+
+	return( n );
+}
+
+/*
+** PUBLIC FUNCTIONS
+*/
+
+/*
+** _prof_modinit()
+**
+** initialize the profiler, and register its device
+*/
+
+void _prof_modinit( void ) {
+
+	for( int i = 0; i < PROF_BUCKETS; ++i ) {
+		_prof_buckets[i] = 0;
+	}
+
+	for( int i = 0; i < PROF_PIDS; ++i ) {
+		_prof_pids[i].count = 0;
+	}
+
+	_prof_next = _prof_other = 0;
+	_prof_phase = PHASE_HEADER;
+
+	_dev_register( DEV_PROF, &_prof_device );
+
+	c_puts( " PROF" );
+}
+
+/*
+** _prof_sample()
+**
+** called by the clock ISR to take a sample of the current process
+*/
+
+void _prof_sample( void ) {
+	context_t *context;
+	prof_sample_t *sample;
+	uint32_t eip, fp, lo, hi;
+	int i;
+
+	if( _current == NULL ) {
+		return;
+	}
+
+	context = _current->context;
+	eip = context->eip;
+
+	// the histogram
+
+	i = (eip - (uint32_t) begtext) >> PROF_SHIFT;
+	if( eip >= (uint32_t) begtext && eip < (uint32_t) etext &&
+	    i < PROF_BUCKETS ) {
+		++_prof_buckets[i];
+	} else {
+		++_prof_other;
+	}
+
+	// the PID count; a full table just loses the sample
+
+	for( i = 0; i < PROF_PIDS; ++i ) {
+		if( _prof_pids[i].count == 0 ) {
+			_prof_pids[i].pid = _current->pid;
+		}
+		if( _prof_pids[i].pid == _current->pid ) {
+			++_prof_pids[i].count;
+			break;
+		}
+	}
+
+	// the call chain; stop at anything outside this process' stack
+
+	sample = &_prof_ring[ _prof_next++ % PROF_RING ];
+	sample->pid = _current->pid;
+	sample->pc[0] = eip;
+
+	lo = (uint32_t) _current->stack;
+	hi = lo + sizeof(stack_t);
+	fp = context->ebp;
+
+	for( i = 1; i <= PROF_DEPTH; ++i ) {
+		if( fp < lo || fp > hi - 8 || (fp & 3) != 0 ) {
+			break;
+		}
+		sample->pc[i] = ((uint32_t *) fp)[1];
+		if( sample->pc[i] == 0 || ((uint32_t *) fp)[0] <= fp ) {
+			++i;
+			break;
+		}
+		fp = ((uint32_t *) fp)[0];
+	}
+
+	if( i <= PROF_DEPTH ) {
+		sample->pc[i] = 0;
+	}
+}
+
+#else
+
+/*
+** _prof_modinit()
+**
+** the profiler isn't configured
+*/
+
+void _prof_modinit( void ) {
+}
+
+#endif
@@ -260,6 +260,50 @@ void *_queue_remove( queue_t queue ) {
 	return( data );
 }
 
+/*
+** _queue_delete()
+**
+** remove a specific element from the queue
+**
+** returns the thing that was removed, or NULL if it wasn't there
+*/
+
+void *_queue_delete( queue_t queue, void *data ) {
+	qnode_t *prev, *curr;
+
+#ifdef DEBUG
+	if( queue == NULL ) {
+		_kpanic( "_queue_delete", "NULL queue" );
+	}
+#endif
+
+	prev = NULL;
+	curr = queue->first;
+
+	while( curr != NULL && curr->data != data ) {
+		prev = curr;
+		curr = curr->next;
+	}
+
+	if( curr == NULL ) {
+		return( NULL );
+	}
+
+	if( prev == NULL ) {
+		queue->first = curr->next;
+	} else {
+		prev->next = curr->next;
+	}
+	if( queue->last == curr ) {
+		queue->last = prev;
+	}
+	queue->size -= 1;
+
+	_qnode_dealloc( curr );
+
+	return( data );
+}
+
 /*
 ** _queue_insert()
 **
@@ -34,6 +34,7 @@
 
 pcb_t *_current;		// the currently-running process
 queue_t _ready[N_READY];	// the MLQ ready queue structure
+uint8_t _need_resched;		// check for preemption at ISR exit?
 
 /*
 ** PRIVATE FUNCTIONS
@@ -64,6 +65,7 @@ void _sched_modinit( void ) {
 	// no current process, initially
 
 	_current = NULL;
+	_need_resched = 0;
 
 	// report that we have finished
 
@@ -129,3 +131,50 @@ void _dispatch( void ) {
 
 	_kpanic( "_dispatch", "no ready processes!?!?!" );
 }
+
+/*
+** _dispatch_to(pcb)
+**
+** give the CPU directly to a specific process, bypassing the
+** ready queues (the process must not be on one of them)
+*/
+
+void _dispatch_to( pcb_t *pcb ) {
+
+#ifdef DEBUG
+	if( pcb == NULL ) {
+		_kpanic( "_dispatch_to", "NULL pcb pointer" );
+	}
+#endif
+
+	_current = pcb;
+	_current->state = STATE_RUNNING;
+	_current->quantum = _current->default_quantum;
+}
+
+/*
+** _resched()
+**
+** called on the way out of an ISR which set _need_resched:  if a
+** process with a higher priority than the current one is ready,
+** preempt the current process in its favor
+*/
+
+void _resched( void ) {
+
+	_need_resched = 0;
+
+	// the ISR may already have blocked or replaced the process
+
+	if( _current->state != STATE_RUNNING ) {
+		return;
+	}
+
+	for( int i = 0; i < _current->prio; ++i ) {
+		if( !_queue_empty(_ready[i]) ) {
+			_schedule( _current );
+			_dispatch();
+			return;
+		}
+	}
+}
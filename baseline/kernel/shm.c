@@ -0,0 +1,190 @@
+/*
+** SCCS ID:	%W%	%G%
+**
+** File:	shm.c
+**
+** Author:	CSCI-452 class of 20145
+**
+** Contributor:
+**
+** Description:	Shared memory segment implementation
+**
+** Each process has a bit mask of the segments it has attached.  A
+** segment's reference count is the number of processes with its bit
+** set; the creator is attached automatically.  When the count drops
+** to zero, the segment's pages go back to the page pool.
+*/
+
+#define	__SP_KERNEL__
+
+#include "common.h"
+
+#include "shm.h"
+#include "page.h"
+#include "process.h"
+
+/*
+** PRIVATE DEFINITIONS
+*/
+
+#define	SHM_BIT(id)	(1UL << (id))
+
+/*
+** PRIVATE DATA TYPES
+*/
+
+// a shared memory segment
+
+typedef struct shmseg {
+	void		*base;		// first page of the segment
+	uint32_t	npages;		// length, in pages
+	uint32_t	refs;		// # of attached processes
+} shmseg_t;
+
+/*
+** PRIVATE GLOBAL VARIABLES
+*/
+
+static shmseg_t _shmsegs[ N_SHMSEGS ];	// all segments in the system
+
+/*
+** PUBLIC GLOBAL VARIABLES
+*/
+
+/*
+** PRIVATE FUNCTIONS
+*/
+
+/*
+** PUBLIC FUNCTIONS
+*/
+
+/*
+** _shm_modinit()
+**
+** initialize the shared memory module
+*/
+
+void _shm_modinit( void ) {
+
+	_memset( (void *) _shmsegs, sizeof(_shmsegs), 0 );
+
+	c_puts( " SHM" );
+}
+
+/*
+** _shm_create(pcb,size)
+**
+** create a segment of at least 'size' bytes, attached to 'pcb'
+**
+** returns the segment id, or -1 on failure
+*/
+
+int _shm_create( pcb_t *pcb, uint32_t size ) {
+	shmseg_t *seg;
+	int id;
+
+	if( size == 0 ) {
+		return( -1 );
+	}
+
+	// find an unused segment descriptor
+
+	for( id = 0; id < N_SHMSEGS; ++id ) {
+		if( _shmsegs[id].base == NULL ) {
+			break;
+		}
+	}
+
+	if( id >= N_SHMSEGS ) {
+		return( -1 );
+	}
+
+	// carve the segment out of the page pool
+
+	seg = &_shmsegs[id];
+	seg->npages = BYTES_TO_PAGES(size);
+	seg->base = _page_alloc( seg->npages, PAGE_OWNER_KERNEL );
+	if( seg->base == NULL ) {
+		seg->npages = 0;
+		return( -1 );
+	}
+
+	_memset( (uint8_t *) seg->base, seg->npages << PAGE_SHIFT, 0 );
+
+	// the creator is the first attached process
+
+	seg->refs = 1;
+	pcb->shm_mask |= SHM_BIT(id);
+
+	return( id );
+}
+
+/*
+** _shm_attach(pcb,id)
+**
+** attach segment 'id' to 'pcb'
+**
+** returns the address of the segment, or NULL on failure
+*/
+
+void *_shm_attach( pcb_t *pcb, int id ) {
+
+	if( id < 0 || id >= N_SHMSEGS || _shmsegs[id].base == NULL ) {
+		return( NULL );
+	}
+
+	// attaching a segment twice doesn't add a reference
+
+	if( (pcb->shm_mask & SHM_BIT(id)) == 0 ) {
+		pcb->shm_mask |= SHM_BIT(id);
+		_shmsegs[id].refs += 1;
+	}
+
+	return( _shmsegs[id].base );
+}
+
+/*
+** _shm_detach(pcb,id)
+**
+** detach segment 'id' from 'pcb', releasing it if this was the
+** last attached process
+**
+** returns 0 on success, -1 on failure
+*/
+
+int _shm_detach( pcb_t *pcb, int id ) {
+	shmseg_t *seg;
+
+	if( id < 0 || id >= N_SHMSEGS ||
+	    (pcb->shm_mask & SHM_BIT(id)) == 0 ) {
+		return( -1 );
+	}
+
+	pcb->shm_mask &= ~SHM_BIT(id);
+
+	seg = &_shmsegs[id];
+	seg->refs -= 1;
+	if( seg->refs == 0 ) {
+		_page_free( seg->base, seg->npages );
+		seg->base = NULL;
+		seg->npages = 0;
+	}
+
+	return( 0 );
+}
+
+/*
+** _shm_release(pcb)
+**
+** detach all segments attached to 'pcb'
+*/
+
+void _shm_release( pcb_t *pcb ) {
+
+	for( int id = 0; pcb->shm_mask != 0 && id < N_SHMSEGS; ++id ) {
+		if( pcb->shm_mask & SHM_BIT(id) ) {
+			_shm_detach( pcb, id );
+		}
+	}
+}
@@ -212,6 +212,7 @@ static void init_idt( void ){
 void __panic( char *reason ){
 	__asm( "cli" );
 	c_printf( "\nPANIC: %s\nHalting...", reason );
+	c_flush();
 	for(;;){
 		;
 	}
@@ -20,7 +20,10 @@
 #include "stack.h"
 #include "queue.h"
 #include "scheduler.h"
-#include "sio.h"
+#include "device.h"
+#include "shm.h"
+#include "ipc.h"
+#include "page.h"
 
 #include "support.h"
 #include "startup.h"
@@ -119,6 +122,14 @@ static void _sys_isr( int vector, int code ) {
 
 static void _sys_exit( pcb_t *pcb ) {
 
+	// let go of any shared memory segments
+
+	_shm_release( pcb );
+
+	// fail anyone waiting to talk to us, and free our pages
+
+	_ipc_release( pcb );
+
 	// tear down the PCB structure
 
 	_stack_dealloc( pcb->stack );
@@ -131,6 +142,40 @@ static void _sys_exit( pcb_t *pcb ) {
 	}
 }
 
+/*
+** _spawn - create a child process of 'pcb' running the program
+** and at the priority given by its first two syscall arguments
+**
+** returns:
+**	the new PCB (not yet scheduled), or NULL on error
+*/
+
+static pcb_t *_spawn( pcb_t *pcb ) {
+	pcb_t *new;
+
+	// farm out all the work to this supporting routine
+
+	new = _create_process( (uint32_t) ARG(1,pcb->context),
+				(uint32_t) ARG(2,pcb->context) );
+
+	if( new != NULL ) {
+
+		// it succeeded - set the parent PID
+
+		new->ppid = pcb->pid;
+
+		// and our timer slack
+
+		new->slack = pcb->slack;
+
+		// the child inherits our open descriptors
+
+		_dev_fd_init( new, pcb );
+	}
+
+	return( new );
+}
+
 /*
 ** _sys_spawnp - create a new process running the specified program
 **
@@ -143,22 +188,55 @@ static void _sys_exit( pcb_t *pcb ) {
 static void _sys_spawnp( pcb_t *pcb ) {
 	pcb_t *new;
 
-	// farm out all the work to this supporting routine
-
-	new = _create_process( (uint32_t) ARG(1,pcb->context),
-				(uint32_t) ARG(2,pcb->context) );
+	new = _spawn( pcb );
 
 	if( new == NULL ) {
 
 		// it failed - tell the parent
 		RET(pcb->context) = -1;
 
-
 	} else {
 
-		// it succeeded - set the parent PID
+		// tell the parent
+		RET(pcb->context) = new->pid;
 
-		new->ppid = pcb->pid;
+		// schedule the child
+
+		_schedule( new );
+	}
+}
+
+/*
+** _sys_spawnc - create a new process on a virtual console
+**
+** implements:  int spawnc( void (*entry)(void), prio, console );
+**
+** as spawnp(), but the child's FD_CONSOLE is virtual console 'console'
+**
+** returns:
+**	pid of new process in original process, or -1 on error
+*/
+
+static void _sys_spawnc( pcb_t *pcb ) {
+	uint32_t vc = ARG(3,pcb->context);
+	pcb_t *new;
+
+	if( vc >= C_CONSOLES ) {
+		RET(pcb->context) = -1;
+		return;
+	}
+
+	new = _spawn( pcb );
+
+	if( new == NULL ) {
+
+		// it failed - tell the parent
+		RET(pcb->context) = -1;
+
+	} else {
+
+		// switch its console
+		new->fds[ FD_CONSOLE ] = DEV_VC( vc );
 
 		// tell the parent
 		RET(pcb->context) = new->pid;
@@ -169,7 +247,6 @@ static void _sys_spawnp( pcb_t *pcb ) {
 	}
 }
 
-
 /*
 ** _sys_sleep - put the current process to sleep for some length of time
 **
@@ -192,14 +269,8 @@ static void _sys_sleep( pcb_t *pcb ) {
 
 	} else {
 
-		// calculate the wakeup time for the process
-		pcb->wakeup = _system_time + MS_TO_TICKS(sleeptime);
-
-		// mark it as sleeping
-		pcb->state = STATE_SLEEPING;
-
-		// add it to the sleep queue
-		_queue_insert( _sleeping, (void *)pcb, (void *) pcb->wakeup );
+		// put it on the sleep queue until its wakeup time
+		_clock_sleep( pcb, MS_TO_TICKS(sleeptime) );
 
 	}
 
@@ -208,6 +279,24 @@ static void _sys_sleep( pcb_t *pcb ) {
 	_dispatch();
 }
 
+/*
+** _sys_sleep_slack - sleep, allowing the wakeup to be late
+**
+** implements:	void sleep_slack(uint32_t ms, uint32_t slack);
+**
+** Sets the timer slack of the process to 'slack' milliseconds, then
+** sleeps as sleep(ms) does.  The slack applies to this and all later
+** sleeps, and is inherited by processes spawned afterward.
+*/
+
+static void _sys_sleep_slack( pcb_t *pcb ) {
+	uint32_t slack = MS_TO_TICKS( (uint32_t) ARG(2,pcb->context) );
+
+	pcb->slack = slack > SLACK_MAX ? SLACK_MAX : slack;
+
+	_sys_sleep( pcb );
+}
+
 /*
 ** _sys_get_process_info - retrieve information about a process
 **
@@ -275,6 +364,14 @@ static void _sys_get_process_info( pcb_t *pcb ) {
 			RET(pcb->context) = target->default_quantum;
 			break;
 
+		case INFO_SLACK:
+			RET(pcb->context) = target->slack;
+			break;
+
+		case INFO_STACK:
+			RET(pcb->context) = (uint32_t) target->stack;
+			break;
+
 		default:
 			RET(pcb->context) = -1;
 	}
@@ -324,53 +421,15 @@ static void _sys_get_system_info( pcb_t *pcb ) {
 ** whichever is smaller
 **
 ** returns:
-**	the count of characters read in
+**	the count of characters read in, or -1 on error
 */
 
 static void _sys_read( pcb_t *pcb ) {
 	int fd = (int) ARG(1,pcb->context);
 	char *buf = (char *) ARG(2, pcb->context);
 	int count = (int) ARG(3,pcb->context);
-	int n;
-	int (*qlength)(void);
-	int (*getchar)(void);
-
-	// set function pointers based on the stream
-
-	if( fd == FD_CONSOLE ) {
-		qlength = c_input_queue;
-		getchar = c_getchar;
-	} else if( fd == FD_SIO ) {
-		qlength = _sio_input_queue;
-		getchar = _sio_readc;
-	} else {
-		RET(pcb->context) = -1;
-		return;
-	}
-
-	n = qlength();
-
-	// if there are characters, read in the desired number of them
-
-	if( n > 0 ) {
-
-		// don't read more than the user wants, or more
-		// characters than there are in the buffer
-
-		if( n > count ) {
-			n = count;
-		} else {
-			count = n;
-		}
-
-		while( count-- ) {
-			*buf++ = getchar();
-		}
-
-	}
-
-	RET(pcb->context) = n;
 
+	RET(pcb->context) = _dev_read( pcb, fd, buf, count );
 }
 
 /*
@@ -382,7 +441,7 @@ static void _sys_read( pcb_t *pcb ) {
 ** otherwise, write 'count' bytes
 **
 ** returns:
-**	the count of characters written
+**	the count of characters written, or -1 on error
 */
 
 static void _sys_write( pcb_t *pcb ) {
@@ -390,30 +449,226 @@ static void _sys_write( pcb_t *pcb ) {
 	char *buf = (char *) ARG(2,pcb->context);
 	int count = (int) ARG(3,pcb->context);
 
-	if( fd == FD_CONSOLE ) {
+	RET(pcb->context) = _dev_write( pcb, fd, buf, count );
+}
 
-		if( count == 0 ) {
-			RET(pcb->context) = c_puts( buf );
-		} else {
-			c_putbuf( buf, count );
-			RET(pcb->context) = count;
+/*
+** _sys_ioctl - perform a device control request
+**
+** implements:	int ioctl( int fd, int request, uint32_t arg );
+**
+** returns:
+**	a request-specific value, or -1 on error
+*/
+
+static void _sys_ioctl( pcb_t *pcb ) {
+	int fd = (int) ARG(1,pcb->context);
+	int request = (int) ARG(2,pcb->context);
+	uint32_t arg = ARG(3,pcb->context);
+
+	RET(pcb->context) = _dev_ioctl( pcb, fd, request, arg );
+}
+
+/*
+** _sys_poll - wait for descriptors to become ready
+**
+** implements:	int poll( pollfd_t *fds, int nfds, int32_t timeout );
+**
+** blocks until a descriptor is ready or the timeout expires
+**
+** returns:
+**	the number of ready descriptors, or -1 on error
+*/
+
+static void _sys_poll( pcb_t *pcb ) {
+
+	_dev_poll( pcb );
+}
+
+/*
+** _sys_clock_ns - read the high-resolution clock
+**
+** implements:	uint64_t clock_ns( void );
+**
+** returns:
+**	nanoseconds since boot (in EDX:EAX)
+*/
+
+static void _sys_clock_ns( pcb_t *pcb ) {
+	uint64_t ns = _clock_ns();
+
+	RET(pcb->context) = (uint32_t) ns;
+	pcb->context->edx = (uint32_t) (ns >> 32);
+}
+
+/*
+** _sys_shm_create - create a shared memory segment
+**
+** implements:	int shm_create( uint32_t size );
+**
+** returns:
+**	the segment id, or -1 on error
+*/
+
+static void _sys_shm_create( pcb_t *pcb ) {
+	uint32_t size = (uint32_t) ARG(1,pcb->context);
+
+	RET(pcb->context) = _shm_create( pcb, size );
+}
+
+/*
+** _sys_shm_attach - attach a shared memory segment
+**
+** implements:	void *shm_attach( int id );
+**
+** returns:
+**	the address of the segment, or NULL on error
+*/
+
+static void _sys_shm_attach( pcb_t *pcb ) {
+	int id = (int) ARG(1,pcb->context);
+
+	RET(pcb->context) = (uint32_t) _shm_attach( pcb, id );
+}
+
+/*
+** _sys_shm_detach - detach a shared memory segment
+**
+** implements:	int shm_detach( int id );
+**
+** returns:
+**	0 on success, or -1 on error
+*/
+
+static void _sys_shm_detach( pcb_t *pcb ) {
+	int id = (int) ARG(1,pcb->context);
+
+	RET(pcb->context) = _shm_detach( pcb, id );
+}
+
+/*
+** _sys_send - send a message to another process
+**
+** implements:	int send( int16_t pid, msg_t *msg );
+**
+** blocks until the receiver has taken the message
+**
+** returns:
+**	0 on success, or -1 on error
+*/
+
+static void _sys_send( pcb_t *pcb ) {
+
+	_ipc_send( pcb );
+}
+
+/*
+** _sys_receive - receive a message from another process
+**
+** implements:	int receive( int16_t *from, msg_t *buf );
+**
+** if '*from' is IPC_ANY, accepts a message from any process;
+** blocks until a message arrives
+**
+** returns:
+**	0 on success (with '*from' set to the sender), or -1 on error
+*/
+
+static void _sys_receive( pcb_t *pcb ) {
+
+	_ipc_receive( pcb );
+}
+
+/*
+** _sys_page_alloc - allocate contiguous pages
+**
+** implements:	void *page_alloc( uint32_t npages );
+**
+** returns:
+**	the address of the first page, or NULL on error
+*/
+
+static void _sys_page_alloc( pcb_t *pcb ) {
+	uint32_t npages = (uint32_t) ARG(1,pcb->context);
+
+	RET(pcb->context) = (uint32_t) _page_alloc( npages, pcb->pid );
+}
+
+/*
+** _sys_sbrk - move the end of the heap
+**
+** implements:	void *sbrk( int32_t incr );
+**
+** The first call reserves HEAP_PAGES pages from the page pool for
+** the heap.  A heap which outgrows its pages is extended into the
+** pages which follow it, if they are free; there is no memory
+** mapping, so it can't be moved.  Shrinking the heap keeps its
+** pages.  They are all released when the process exits.
+**
+** returns:
+**	the previous end of the heap, or (void *) -1 on error
+*/
+
+static void _sys_sbrk( pcb_t *pcb ) {
+	int32_t incr = (int32_t) ARG(1,pcb->context);
+	uint32_t end, npages;
+	void *base;
+
+	if( pcb->heap == 0 ) {
+		base = _page_alloc( HEAP_PAGES, pcb->pid );
+		if( base == NULL ) {
+			RET(pcb->context) = (uint32_t) -1;
+			return;
 		}
+		pcb->heap = pcb->brk = (uint32_t) base;
+		pcb->heap_pages = HEAP_PAGES;
+	}
 
-	} else if( fd == FD_SIO ) {
+	// the new end must lie between the start of the heap and the
+	// top of the address space
+
+	end = pcb->brk + incr;
+	if( (incr >= 0 && end < pcb->brk) ||
+	    (incr < 0 && (end < pcb->heap || end > pcb->brk)) ) {
+		RET(pcb->context) = (uint32_t) -1;
+		return;
+	}
 
-		if( count == 0 ) {
-			RET(pcb->context) = _sio_puts( buf );
-		} else {
-			_sio_writes( buf, count );
-			RET(pcb->context) = count;
+	npages = BYTES_TO_PAGES( end - pcb->heap );
+	if( npages > pcb->heap_pages ) {
+		if( !_page_claim((void *) (pcb->heap + pcb->heap_pages * PAGE_SIZE),
+				 npages - pcb->heap_pages, pcb->pid) ) {
+			RET(pcb->context) = (uint32_t) -1;
+			return;
 		}
+		pcb->heap_pages = npages;
+	}
 
-	} else {	// bad parameter!
+	RET(pcb->context) = pcb->brk;
+	pcb->brk = end;
+}
 
-		RET(pcb->context) = -1;
+/*
+** _sys_page_free - release pages
+**
+** implements:	int page_free( void *addr, uint32_t npages );
+**
+** returns:
+**	0 on success, or -1 if the caller doesn't own all the pages
+**	(or the range is empty or not page-aligned)
+*/
 
+static void _sys_page_free( pcb_t *pcb ) {
+	uint8_t *addr = (uint8_t *) ARG(1,pcb->context);
+	uint32_t npages = (uint32_t) ARG(2,pcb->context);
+
+	if( !_page_owns(addr,npages,pcb->pid) ) {
+		RET(pcb->context) = -1;
+		return;
 	}
 
+	_page_free( addr, npages );
+	RET(pcb->context) = 0;
 }
 
 /*
@@ -451,6 +706,19 @@ void _sys_modinit( void ) {
 	_syscalls[ SYS_write ]            = _sys_write;
 	_syscalls[ SYS_get_process_info ] = _sys_get_process_info;
 	_syscalls[ SYS_get_system_info ]  = _sys_get_system_info;
+	_syscalls[ SYS_shm_create ]       = _sys_shm_create;
+	_syscalls[ SYS_shm_attach ]       = _sys_shm_attach;
+	_syscalls[ SYS_shm_detach ]       = _sys_shm_detach;
+	_syscalls[ SYS_send ]             = _sys_send;
+	_syscalls[ SYS_receive ]          = _sys_receive;
+	_syscalls[ SYS_page_alloc ]       = _sys_page_alloc;
+	_syscalls[ SYS_page_free ]        = _sys_page_free;
+	_syscalls[ SYS_poll ]             = _sys_poll;
+	_syscalls[ SYS_clock_ns ]         = _sys_clock_ns;
+	_syscalls[ SYS_sleep_slack ]      = _sys_sleep_slack;
+	_syscalls[ SYS_ioctl ]            = _sys_ioctl;
+	_syscalls[ SYS_spawnc ]           = _sys_spawnc;
+	_syscalls[ SYS_sbrk ]             = _sys_sbrk;
 
 	// install our ISR
 
@@ -19,7 +19,14 @@
 #include "process.h"
 #include "bootstrap.h"
 #include "syscall.h"
+#include "device.h"
+#include "defer.h"
+#include "ktimer.h"
+#include "profile.h"
+#include "klog.h"
 #include "sio.h"
+#include "page.h"
+#include "shm.h"
 #include "net.h"
 #include "pci.h"
 #include "scheduler.h"
@@ -131,8 +138,13 @@ pcb_t *_create_process( uint32_t entry, uint8_t prio ) {
 	new->prio = prio;
 	new->pid  = _next_pid++;
 	new->default_quantum = QUANTUM_DEFAULT;
+	new->slack = SLACK_DEFAULT;
 	new->state = STATE_READY;
 
+	// start out with the initial descriptor table
+
+	_dev_fd_init( new, NULL );
+
 	// all done - return the new PCB
 
 	return( new );
@@ -155,6 +167,13 @@ void _init( void ) {
 	*/
 
 	__init_interrupts();	// IDT and PIC initialization
+	_mem_modinit();		// before any large block moves
+
+	// processor exceptions panic with a traceback
+
+	for( int vec = INT_VEC_DIVIDE_ERROR; vec < INT_VEC_TIMER; ++vec ) {
+		__install_isr( vec, _kpanic_isr );
+	}
 
 	/*
 	** Console I/O system.
@@ -172,7 +191,8 @@ void _init( void ) {
 	** Initialize various OS modules
 	**
 	** Note:  the clock, SIO, and syscall modules also install
-	** their ISRs.
+	** their ISRs; drivers also register their devices, which
+	** must happen before the first process is created.
 	*/
 
 	c_puts( "Module init: " );
@@ -180,7 +200,14 @@ void _init( void ) {
 	_queue_modinit();		// must be first
 	_pcb_modinit();
 	_stack_modinit();
+	_page_modinit();
+	_shm_modinit();
 	_sched_modinit();
+	_defer_modinit();
+	_ktimer_modinit();
+	_dev_modinit();			// before any drivers
+	_prof_modinit();
+	_klog_modinit();
 	_sio_modinit();
 	_sys_modinit();
 	_clock_modinit();
@@ -216,6 +243,12 @@ void _init( void ) {
 
 	_schedule( pcb );
 
+	/*
+	** Next, create the deferred work process
+	*/
+
+	_defer_start();
+
 	/*
 	** Next, create the idle process
 	*/
@@ -1,3 +1,5 @@
+#define __SP_KERNEL__
+
 #include "net.h"
 #include "pci.h"
 #include "x86arch.h"
@@ -6,6 +8,9 @@
 #include "klib.h"
 #include "c_io.h"
 #include "common.h"
+#include "device.h"
+#include "defer.h"
+#include "klog.h"
 #include "net_analyze.h"
 
 rfd rx_buf[RFD_COUNT];
@@ -18,6 +23,32 @@ rfd *rx_cur = NULL;
 net8255x *netdev;
 mac_addr my_mac;
 
+/*
+** Received frames waiting to be read through the net device
+** Frames are added at rx_q_tail and read at rx_q_head; when the
+** queue is full, new frames are dropped.
+*/
+static struct {
+    uint16_t len;
+    uint8_t data[RFD_DATA_SIZE];
+} rx_q[NET_RXQ_LEN];
+static uint32_t rx_q_head = 0;
+static uint32_t rx_q_tail = 0;
+
+static int net_dev_read(device_t *dev, char *buf, int count);
+static int net_dev_write(device_t *dev, char *buf, int count);
+static int net_dev_poll(device_t *dev);
+
+static device_t net_device = {
+    "net", net_dev_read, net_dev_write, net_dev_poll, NULL, NULL
+};
+
+/*
+** Deferred work queued by the ISR
+*/
+static void net_rx_work(void *arg);
+static defer_t net_rx_defer = DEFER_INIT(net_rx_work, NULL);
+
 /*
 ** Initialize
 ** Return: 0 on Success, <0 on Error
@@ -147,16 +178,63 @@ int _net_modinit() {
 #   endif
     //Register ISR
     __install_isr( netdev->pci->irq + 0x20, net_isr );
+
+    // Plug into the device switch
+    if (_dev_register(DEV_NET, &net_device) < 0) {
+        return -1;
+    }
     return 0;
 }
 
+/*
+** Net device read: copy out the oldest received frame's data
+** Return: Number of bytes copied (0 if no frame is waiting)
+*/
+static int net_dev_read(device_t *dev, char *buf, int count) {
+    (void)dev;
+    if (rx_q_head == rx_q_tail) {
+        return 0;
+    }
+    uint32_t slot = rx_q_head % NET_RXQ_LEN;
+    if (count > rx_q[slot].len) {
+        count = rx_q[slot].len;
+    }
+    _memcpy((uint8_t *)buf, (uint8_t *)rx_q[slot].data, count);
+    ++rx_q_head;
+    return count;
+}
+
+/*
+** Net device write: broadcast one frame
+** Return: Number of bytes sent
+*/
+static int net_dev_write(device_t *dev, char *buf, int count) {
+    (void)dev;
+    mac_addr bcast;
+    for (int i = 0; i < MAC_LEN; ++i) {
+        bcast.addr[i] = 0xff;
+    }
+    if (count > RFD_DATA_SIZE) {
+        count = RFD_DATA_SIZE;
+    }
+    return net_write(bcast, buf, count);
+}
+
+/*
+** Net device poll: readable when a frame is queued
+*/
+static int net_dev_poll(device_t *dev) {
+    (void)dev;
+    return (rx_q_head != rx_q_tail ? POLLIN : 0) | POLLOUT;
+}
+
 
 /*
 ** Write a byte cmd to SCB
 */
 void net_cmd_writeb(uint8_t offset, uint8_t cmd){
 #   ifdef _net_debug_
-    c_printf("[net.c][net_cmd_writeb]: Writing %x to %x.\n", cmd, netdev->scb+offset);
+    _klog(KLOG_DEBUG, "[net.c][net_cmd_writeb]: Writing %x to %x.", cmd, netdev->scb+offset);
 #   endif
     __outb(netdev->scb + offset,cmd);
     if (offset == SCB_COMMAND) {
@@ -169,7 +247,7 @@ void net_cmd_writeb(uint8_t offset, uint8_t cmd){
 */
 void net_cmd_writew(uint8_t offset, uint16_t cmd){
 #   ifdef _net_debug_
-    c_printf("[net.c][net_cmd_writew]: Writing %x to %x.\n", cmd, netdev->scb+offset);
+    _klog(KLOG_DEBUG, "[net.c][net_cmd_writew]: Writing %x to %x.", cmd, netdev->scb+offset);
 #   endif
     __outw(netdev->scb + offset,cmd);
     if (offset == SCB_COMMAND) {
@@ -182,7 +260,7 @@ void net_cmd_writew(uint8_t offset, uint16_t cmd){
 */
 void net_cmd_writel(uint8_t offset, uint32_t cmd){
 #   ifdef _net_debug_
-        c_printf("[net.c][net_cmd_writel]: Writing %x to %x.\n", cmd, netdev->scb+offset);
+        _klog(KLOG_DEBUG, "[net.c][net_cmd_writel]: Writing %x to %x.", cmd, netdev->scb+offset);
 #   endif
     __outl(netdev->scb + offset,cmd);
     if (offset == SCB_COMMAND) {
@@ -195,7 +273,7 @@ void net_cmd_writel(uint8_t offset, uint32_t cmd){
 */
 uint8_t net_cmd_readb(uint8_t offset){
 #   ifdef _net_debug_
-        c_printf("[net.c][net_cmd_readb]: Reading byte from %x.\n", netdev->scb+offset);
+        _klog(KLOG_DEBUG, "[net.c][net_cmd_readb]: Reading byte from %x.", netdev->scb+offset);
 #   endif
     return ( __inb(netdev->scb + offset) );
 }
@@ -205,7 +283,7 @@ uint8_t net_cmd_readb(uint8_t offset){
 */
 uint16_t net_cmd_readw(uint8_t offset){
 #   ifdef _net_debug_
-        c_printf("[net.c][net_cmd_readw]: Reading word from %x.\n", netdev->scb+offset);
+        _klog(KLOG_DEBUG, "[net.c][net_cmd_readw]: Reading word from %x.", netdev->scb+offset);
 #   endif
     return ( __inw(netdev->scb + offset) );
 }
@@ -215,7 +293,7 @@ uint16_t net_cmd_readw(uint8_t offset){
 */
 uint32_t net_cmd_readl(uint8_t offset){
 #   ifdef _net_debug_
-        c_printf("[net.c][net_cmd_readl]: Reading long %x.\n", netdev->scb+offset);
+        _klog(KLOG_DEBUG, "[net.c][net_cmd_readl]: Reading long %x.", netdev->scb+offset);
 #   endif
     return ( __inl(netdev->scb + offset) );
 }
@@ -229,13 +307,13 @@ int net_cmd_wait(){
     while ( (cmd = __inb(netdev->scb + SCB_COMMAND)) )
     {
 #       ifdef _net_debug_
-        c_printf("[net.c][net_cmd_wait]: SCB CMD: %x, Waiting on SCB CMD. %x\n", netdev->scb + SCB_COMMAND, cmd);
+        _klog(KLOG_DEBUG, "[net.c][net_cmd_wait]: SCB CMD: %x, Waiting on SCB CMD. %x", netdev->scb + SCB_COMMAND, cmd);
 #       endif
         __delay(NET_CMD_DELAY);
         count++;
     }
 #   ifdef _net_debug_
-    c_printf("[net.c][net_cmd_wait]: Waited on SCB CMD for %d ticks (%d seconds).\n", count, NET_CMD_DELAY*count/10);
+    _klog(KLOG_DEBUG, "[net.c][net_cmd_wait]: Waited on SCB CMD for %d ticks (%d seconds).", count, NET_CMD_DELAY*count/10);
 #   endif
     return count;
 }
@@ -295,9 +373,7 @@ int net_write(mac_addr dst, char *buf, int nbytes) {
     tx->tx_buf_addr = 0;
     tx->command = SCB_CMD_EL | SCB_CMD_I | SCB_CMD_S | SCB_CMD_TRANS;
     tx->tx_count = RFD_HEAD_SIZE + nbytes;
-    for (int i = 0; i < nbytes; ++i){
-        tx_buf->frame.data[i] = buf[i];
-    }
+    _memcpy((uint8_t *)tx_buf->frame.data, (uint8_t *)buf, nbytes);
 #   ifdef _net_debug_
     c_printf("[net.c][net_write]: Sending frame to \"");
     for (int i = 0; i < MAC_LEN; ++i){
@@ -318,22 +394,135 @@ int net_write(mac_addr dst, char *buf, int nbytes) {
     return nbytes;
 }
 
+/*
+** Deferred receive processing
+** Walks the RFD ring from rx_cur, reporting and analyzing each
+** completed frame and queueing ours for the net device.
+** Runs in the deferred work process, with interrupts enabled.
+*/
+static void net_rx_work(void *arg) {
+    (void)arg;
+    int notify = 0;
+
+    while (rx_cur->status != 0) {
+        
+        int ournet = 1;
+        for (int i = 0; i < MAC_LEN; ++i){
+            if (i < MAC_LEN - 1) {
+                if (rx_cur->frame.mac_src.addr[i] != rx_cur->frame.mac_src.addr[i+1])
+                    ournet = 0;
+            }
+        }
+#       ifdef _net_debug_
+        c_printf("Src: ");
+        for (int i = 0; i < MAC_LEN; ++i){
+            c_printf("%x",rx_cur->frame.mac_src.addr[i]);
+            if (i < MAC_LEN - 1) {
+                c_printf(":");
+                if (rx_cur->frame.mac_src.addr[i] != rx_cur->frame.mac_src.addr[i+1])
+                    ournet = 0;
+            }
+        }
+        c_printf(" Dst: ");
+        for (int i = 0; i < MAC_LEN; ++i){
+            c_printf("%x",(uint8_t)rx_cur->frame.mac_dst.addr[i]);
+            if (i < MAC_LEN - 1) {
+                c_printf(":");
+            }
+        }
+        c_printf(" Proto: %d, Size: %d, Written: %d", rx_cur->frame.proto, rx_cur->size, rx_cur->bytes_written & RFD_BYTE_WRITTEN_MASK);
+#       endif
+        if (ournet) {
+            c_printf("WE GOT A MESSAGE: ");
+            for (int i = 0; i < (rx_cur->bytes_written & RFD_BYTE_WRITTEN_MASK); ++i) {
+                c_printf("%c",rx_cur->frame.data[i]);
+            }
+            c_printf("\n");
+            #ifdef _net_debug_
+            c_printf("Analyzing packet for content.\n");
+            #endif
+            int result;
+            if ((result = analyze_frame(&rx_cur->frame))){
+                c_printf("Signature matched! Signature #: %d\n",result);
+            }
+
+            // Queue it for the net device, if there is room
+            uint32_t flags = _int_disable();
+            if (rx_q_tail - rx_q_head < NET_RXQ_LEN) {
+                uint32_t slot = rx_q_tail % NET_RXQ_LEN;
+                // the actual count includes the MACs and protocol
+                uint16_t len = rx_cur->bytes_written & RFD_ACTUAL_COUNT_MASK;
+                len = len > RFD_HEAD_SIZE ? len - RFD_HEAD_SIZE : 0;
+                if (len > RFD_DATA_SIZE) {
+                    len = RFD_DATA_SIZE;
+                }
+                _memcpy((uint8_t *)rx_q[slot].data,
+                        (uint8_t *)rx_cur->frame.data, len);
+                rx_q[slot].len = len;
+                ++rx_q_tail;
+                notify = 1;
+            }
+            _int_restore(flags);
+        }
+        uint8_t done = 0;
+        //if (cur->command & 0x8000) {
+        if (rx_cur->command & SCB_CMD_EL) {
+            done = 1;
+        }
+        
+        rx_cur->status = 0;
+        rx_cur->command = 0;
+        rx_cur->size = RFD_DATA_SIZE;
+        rx_cur = (rfd *)rx_cur->link_addr;
+        if (done) { break; }
+    }
+
+    // Wake anyone polling for frames
+    if (notify) {
+        uint32_t flags = _int_disable();
+        _dev_notify(&net_device);
+        _int_restore(flags);
+    }
+}
+
+/*
+** Log the RU/CU status seen by an interrupt
+*/
+static void net_log_status(uint8_t scb_status) {
+    uint8_t scb_status_rus = (scb_status & SCB_RUS_MASK);
+    uint8_t scb_status_cus = (scb_status & SCB_CUS_MASK);
+
+    // SCB Status RU Status
+    if (scb_status_rus & SCB_RUS_IDLE) { _klog(KLOG_DEBUG, "[net.c][net_isr] SCB Status RUS: Idle."); }
+    if (scb_status_rus & SCB_RUS_SUSPEND) { _klog(KLOG_DEBUG, "[net.c][net_isr] SCB Status RUS: Suspended."); }
+    if (scb_status_rus & SCB_RUS_NORESOURCE) {
+        _klog(KLOG_WARN, "[net.c][net_isr] SCB Status RUS: No Resources.");
+        _klog(KLOG_WARN, "[net.c][net_isr] RX Buffer @ CUR: Status: %x", rx_cur->status);
+    }
+    if (scb_status_rus & SCB_RUS_READY) { _klog(KLOG_DEBUG, "[net.c][net_isr] SCB Status RUS: Ready."); }
+
+    // SCB Status CU Status
+    if (scb_status_cus & SCB_CUS_IDLE) { _klog(KLOG_DEBUG, "[net.c][net_isr] SCB Status CUS: Idle."); }
+    if (scb_status_cus & SCB_CUS_SUSPEND) { _klog(KLOG_DEBUG, "[net.c][net_isr] SCB Status CUS: Suspended."); }
+    if (scb_status_cus & SCB_CUS_LPQ_ACTIVE) { _klog(KLOG_DEBUG, "[net.c][net_isr] SCB Status CUS: LPQ Active."); }
+    if (scb_status_cus & SCB_CUS_HQP_ACTIVE) { _klog(KLOG_DEBUG, "[net.c][net_isr] SCB Status CUS: HQP Active."); }
+
+    _klog(KLOG_DEBUG, "[net.c][net_isr] SCB_STATUS: %x", scb_status);
+}
+
 /*
 ** Network driver interrupt handler
 ** rx/tx same
+** Only acknowledges the card and logs its status; frame processing
+** is deferred to net_rx_work.
 ** ISSUE: stat/ack = 0x50, rus = 0x08
 */
 void net_isr(int vector, int code){
     (void)code; //shut up compiler
-#   ifdef _net_debug_
-    c_printf("[net.c][net_isr] Interrupt. Vector: %d, Code: %d\n", vector, code);
-#   endif
+    _klog(KLOG_DEBUG, "[net.c][net_isr] Interrupt. Vector: %d, Code: %d", vector, code);
     uint8_t scb_status = net_cmd_readb(SCB_STATUS);
     uint8_t scb_statack = net_cmd_readb(SCB_STATACK) & STATACK_MASK;
 
-    uint8_t scb_status_rus = (scb_status & SCB_RUS_MASK);
-    uint8_t scb_status_cus = (scb_status & SCB_CUS_MASK);
-    
     // SCB Stat/Ack
     if (scb_statack & STATACK_CU_READY ) {
         net_cmd_writeb(SCB_STATACK, STATACK_CU_READY);
@@ -346,71 +535,16 @@ void net_isr(int vector, int code){
     }
 
     if (scb_statack & STATACK_RU_FRAME) {
-#       ifdef _net_debug_
-        c_printf("[net.c][net_isr] RU Frame Finished... cur->status: %x\n",rx_cur->status);
-#       endif
-        while (rx_cur->status != 0) {
-            
-            int ournet = 1;
-            for (int i = 0; i < MAC_LEN; ++i){
-                if (i < MAC_LEN - 1) {
-                    if (rx_cur->frame.mac_src.addr[i] != rx_cur->frame.mac_src.addr[i+1])
-                        ournet = 0;
-                }
-            }
-#           ifdef _net_debug_
-            c_printf("Src: ");
-            for (int i = 0; i < MAC_LEN; ++i){
-                c_printf("%x",rx_cur->frame.mac_src.addr[i]);
-                if (i < MAC_LEN - 1) {
-                    c_printf(":");
-                    if (rx_cur->frame.mac_src.addr[i] != rx_cur->frame.mac_src.addr[i+1])
-                        ournet = 0;
-                }
-            }
-            c_printf(" Dst: ");
-            for (int i = 0; i < MAC_LEN; ++i){
-                c_printf("%x",(uint8_t)rx_cur->frame.mac_dst.addr[i]);
-                if (i < MAC_LEN - 1) {
-                    c_printf(":");
-                }
-            }
-            c_printf(" Proto: %d, Size: %d, Written: %d", rx_cur->frame.proto, rx_cur->size, rx_cur->bytes_written & RFD_BYTE_WRITTEN_MASK);
-#           endif
-            if (ournet) {
-                c_printf("WE GOT A MESSAGE: ");
-                for (int i = 0; i < (rx_cur->bytes_written & RFD_BYTE_WRITTEN_MASK); ++i) {
-                    c_printf("%c",rx_cur->frame.data[i]);
-                }
-                c_printf("\n");
-                #ifdef _net_debug_
-                c_printf("Analyzing packet for content.\n");
-                #endif
-                int result;
-                if ((result = analyze_frame(&rx_cur->frame))){
-                    c_printf("Signature matched! Signature #: %d\n",result);
-                }
-            }
-            uint8_t done = 0;
-            //if (cur->command & 0x8000) {
-            if (rx_cur->command & SCB_CMD_EL) {
-                done = 1;
-            }
-            
-            rx_cur->status = 0;
-            rx_cur->command = 0;
-            rx_cur->size = RFD_DATA_SIZE;
-            rx_cur = (rfd *)rx_cur->link_addr;
-            if (done) { break; }
-        }
+        _klog(KLOG_DEBUG, "[net.c][net_isr] RU Frame Finished... cur->status: %x", rx_cur->status);
         net_cmd_writeb(SCB_STATACK, STATACK_RU_FRAME);
+        _defer(&net_rx_defer);
     }
 
     // Software Interrupt
     if ( scb_statack & STATACK_SWI )
     {
+        _klog(KLOG_DEBUG, "[net.c][net_isr] SCB Statack: SWI -> CU Finished.");
 #       ifdef _net_debug_
-        c_printf("[net.c][net_isr] SCB Statack: SWI -> CU Finished.\n");
         net_cmd_writeb(SCB_STATACK, STATACK_SWI);
 #       endif
     }
@@ -418,34 +552,16 @@ void net_isr(int vector, int code){
     // Flow Control Pause
     if ( scb_statack & STATACK_FLOW_PAUSE )
     {
+        _klog(KLOG_DEBUG, "[net.c][net_isr] SCB Statack: STATACK_FLOW_PAUSE");
 #       ifdef _net_debug_
-        c_printf("[net.c][net_isr] SCB Statack: STATACK_FLOW_PAUSE\n");
         net_cmd_writeb(SCB_STATACK, STATACK_FLOW_PAUSE);
 #       endif
     }
 
-    
-    // SCB Status RU Status
-    if (scb_status_rus & SCB_RUS_IDLE) { c_printf("[net.c][net_isr] SCB Status RUS: Idle.\n"); }
-    if (scb_status_rus & SCB_RUS_SUSPEND) { c_printf("[net.c][net_isr] SCB Status RUS: Suspended.\n"); }
-    if (scb_status_rus & SCB_RUS_NORESOURCE) {
-        c_printf("[net.c][net_isr] SCB Status RUS: No Resources.\n");
-        c_printf("[net.c][net_isr] RX Buffer @ CUR: Status: %x\n", rx_cur->status);
-    }
-#   ifdef _net_debug_
-    if (scb_status_rus & SCB_RUS_READY) { c_printf("[net.c][net_isr] SCB Status RUS: Ready.\n"); }
-#   endif
-
-    // SCB Status CU Status
-    if (scb_status_cus & SCB_CUS_IDLE) { c_printf("[net.c][net_isr] SCB Status CUS: Idle.\n"); }
-    if (scb_status_cus & SCB_CUS_SUSPEND) { c_printf("[net.c][net_isr] SCB Status CUS: Suspended.\n"); }
-    if (scb_status_cus & SCB_CUS_LPQ_ACTIVE) { c_printf("[net.c][net_isr] SCB Status CUS: LPQ Active.\n"); }
-    if (scb_status_cus & SCB_CUS_HQP_ACTIVE) { c_printf("[net.c][net_isr] SCB Status CUS: HQP Active.\n"); }
+    _klog(KLOG_DEBUG, "[net.c][net_isr] SCB_STATACK: %x", scb_statack);
 
-#   ifdef _net_debug_
-    c_printf("[net.c][net_isr] SCB_STATUS: %x\n", scb_status);
-    c_printf("[net.c][net_isr] SCB_STATACK: %x\n", scb_statack);
-#   endif
+    // Log RU/CU status
+    net_log_status(scb_status);
 
     // Acknowledge Interrupt
     __outb( PIC_MASTER_CMD_PORT, PIC_EOI );
@@ -102,11 +102,13 @@ int analyze_frame(netframe *frame) {
 }
 
 int net_analyze_signature(netframe *frame) {
+    (void)(frame);
     /* check for signatures */
     return 0;
 }
 
 int net_analyze_protocol(netframe *frame) {
+    (void)(frame);
     /* check for protocol anomalies */
     return 0;
 }
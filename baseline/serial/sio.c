@@ -23,8 +23,7 @@
 **
 **		Communication with system calls is via two routines.
 **		_sio_readc() returns the first available character (if
-**		there is one), resetting the input variables if this was
-**		the last character in the buffer.  If there are no
+**		there is one).  If there are no
 **		characters in the buffer, _sio_read() returns a -1
 **		(presumably so the requesting process can be blocked).
 **
@@ -46,10 +45,31 @@
 **		a NUL-terminated string.  If we are in the middle of a
 **		transmit sequence, all characters will be added to the
 **		output buffer (from where they will be sent
-**		automatically); otherwise, we send the first character
-**		directly, add the rest of the characters (if there are
-**		any) to the output buffer, and set the "sending" flag
-**		to indicate that we're expecting a transmitter interrupt.
+**		automatically); otherwise, we add them to the output
+**		buffer, fill the transmitter from it directly, and set
+**		the "sending" flag to indicate that we're expecting a
+**		transmitter interrupt.
+**
+**		A write() which doesn't fit blocks the process on the
+**		writer queue (unless nonblocking mode has been selected
+**		with ioctl()).  When the transmitter has drained the
+**		buffer to the low-water mark, the ISR copies in more of
+**		each waiting write, and wakes its process when it is done.
+**
+**	Both buffers are power-of-two rings (see sio_ring_t), and
+**	characters are copied in and out of them in (at most two)
+**	contiguous blocks.  The output ring has two producers (the
+**	writers, and the ISR resuming blocked writes), so characters
+**	are only added to it with interrupts disabled.
+**
+**	Ports:	Each of COM1 through COM4 which is present has its own
+**		state (sio_port_t):  buffers, line settings, writer queue
+**		and statistics.  Each is its own device (DEV_SIO for
+**		COM1, DEV_SIO2 through DEV_SIO4 for the others), so it
+**		has its own file descriptor.  COM1 and COM3 share IRQ 4,
+**		and COM2 and COM4 share IRQ 3; the ISR services every
+**		port on the interrupting line.  The _sio_*() routines
+**		used by the rest of the kernel all work on COM1.
 */
 
 #define	__SP_KERNEL__
@@ -58,6 +78,8 @@
 
 #include "sio.h"
 
+#include "device.h"
+#include "klog.h"
 #include "queue.h"
 #include "process.h"
 #include "scheduler.h"
@@ -71,29 +93,129 @@
 ** PRIVATE DEFINITIONS
 */
 
-#define	BUF_SIZE	2048
+// size of each of the input and output buffers (a power of two)
+
+#ifndef SIO_BUF_SIZE
+#define	SIO_BUF_SIZE	2048
+#endif
+
+#if (SIO_BUF_SIZE & (SIO_BUF_SIZE - 1)) != 0
+#error "SIO_BUF_SIZE must be a power of two"
+#endif
+
+#define	SIO_BUF_MASK	(SIO_BUF_SIZE - 1)
+
+// receive FIFO trigger level (one of the UA5_FCR_RX_FIFO_n values):
+// lower levels mean lower latency, higher levels fewer interrupts
+
+#ifndef SIO_RX_TRIGGER
+#define	SIO_RX_TRIGGER	UA5_FCR_RX_FIFO_8
+#endif
+
+// depth of the 16550 transmit FIFO
+
+#define	SIO_TX_FIFO	16
+
+// the UART's highest bit rate (its clock / 16); some emulated and
+// newer UARTs run faster than the standard 1.8432MHz clock allows
+
+#ifndef SIO_BASE_BAUD
+#define	SIO_BASE_BAUD	115200
+#endif
+
+// initial line settings
+
+#define	SIO_DEFAULT_BAUD	9600
+#define	SIO_DEFAULT_LINE	(SIO_DATA_8 | SIO_STOP_1 | SIO_PARITY_NONE)
+
+// limit on waiting for the transmitter to empty (status reads)
+
+#define	SIO_TXEMP_SPINS	100000
+
+// blocked writers are continued when the output buffer has drained
+// down to this many characters
+
+#define	SIO_LOW_WATER	(SIO_BUF_SIZE / 4)
+
+// number of ports we look for
+
+#define	N_SIO_PORTS	4
+
+// the UA4_* register definitions are for COM1; this relocates
+// one of them to a port
+
+#define	REG(port,reg)	((port)->base + ((reg) - UA4_PORT))
 
 /*
-** PRIVATE GLOBALS
+** PRIVATE DATA TYPES
 */
 
-	// input character buffer
-static char _inbuffer[ BUF_SIZE ];
-static char *_inlast;
-static char *_innext;
-static uint32_t _incount;
+// a character buffer
+//
+// 'head' and 'tail' run freely, and are masked to index 'buf'; the
+// buffer holds (head - tail) characters.  Only the producer changes
+// 'head', and only after storing the characters; only the consumer
+// changes 'tail', and only after taking them.  So, one side can be
+// an ISR and the other a process without any locking.  (A ring with
+// more than one producer needs them to exclude each other; see
+// _port_write().)
+
+typedef struct sio_ring {
+	char			buf[ SIO_BUF_SIZE ];
+	volatile uint32_t	head;	// total characters added
+	volatile uint32_t	tail;	// total characters removed
+} sio_ring_t;
+
+// the state of one port
+
+typedef struct sio_port {
+	sio_ring_t	in;		// input (filled by the ISR)
+	sio_ring_t	out;		// output (emptied by the ISR)
+	device_t	device;		// our entry in the device switch
+	sio_stats_t	stats;		// statistics
+	pcb_t		*change_wait;	// process waiting for a change
+	queue_t		writers;	// processes blocked writing
+	uint16_t	base;		// I/O address
+	uint16_t	divisor;	// current bit rate divisor
+	uint16_t	new_divisor;	// pending change
+	uint8_t		vector;		// interrupt vector
+	uint8_t		devnum;		// device number
+	uint8_t		present;	// did we find it?
+	uint8_t		sending;	// output control flag
+	uint8_t		tx_burst;	// characters per TX interrupt
+	uint8_t		ier;		// interrupt register status
+	uint8_t		line;		// current line format
+	uint8_t		new_line;	// pending change
+	uint8_t		nonblock;	// nonblocking writes?
+} sio_port_t;
 
-	// output character buffer
-static char _outbuffer[ BUF_SIZE ];
-static char *_outlast;
-static char *_outnext;
-static uint32_t _outcount;
-
-	// output control flag
-static int _sending;
+/*
+** PRIVATE GLOBALS
+*/
 
-	// interrupt register status
-static uint8_t _ier;
+	// the ports, and where to find them
+static sio_port_t _ports[ N_SIO_PORTS ];
+
+static const struct {
+	uint16_t base;
+	uint8_t vector;
+	uint8_t devnum;
+	char *name;
+} _port_config[ N_SIO_PORTS ] = {
+	{ UA4_COM1_IOADDR, INT_VEC_SERIAL_PORT_1, DEV_SIO,  "sio" },
+	{ UA4_COM2_IOADDR, INT_VEC_SERIAL_PORT_2, DEV_SIO2, "sio2" },
+	{ UA4_COM3_IOADDR, INT_VEC_SERIAL_PORT_1, DEV_SIO3, "sio3" },
+	{ UA4_COM4_IOADDR, INT_VEC_SERIAL_PORT_2, DEV_SIO4, "sio4" }
+};
+
+	// the kernel's port
+#define	_com1	(&_ports[0])
+
+	// device operations
+static int _sio_dev_read( device_t *dev, char *buf, int count );
+static int _sio_dev_write( device_t *dev, char *buf, int count );
+static int _sio_dev_poll( device_t *dev );
+static int _sio_dev_ioctl( device_t *dev, int request, uint32_t arg );
 
 /*
 ** PUBLIC GLOBAL VARIABLES
@@ -104,130 +226,519 @@ static uint8_t _ier;
 */
 
 /*
-** PUBLIC FUNCTIONS
+** _ring_count(ring)
+**
+** returns the number of characters in 'ring'
 */
 
+static uint32_t _ring_count( sio_ring_t *ring ) {
+
+	return( ring->head - ring->tail );
+}
+
 /*
-** _sio_isr(vector,code)
+** _ring_put(ring,buf,len)
+**
+** add up to 'len' characters from 'buf' to 'ring'
 **
-** Interrupt handler for the SIO module.  Handles all pending
-** events (as described by the SIO controller).
+** returns the number of characters added
 */
 
-static void _sio_isr( int vector, int code ) {
-	(void)(vector);
-	(void)(code);
+static int _ring_put( sio_ring_t *ring, char *buf, int len ) {
+	uint32_t space = SIO_BUF_SIZE - (ring->head - ring->tail);
+	uint32_t at = ring->head & SIO_BUF_MASK;
+	uint32_t first;
 
-	int eir, lsr, msr;
-	int ch;
+	if( (uint32_t) len > space ) {
+		len = space;
+	}
 
-	//
-	// Must process all pending events; loop until the EIR
-	// says there's nothing else to do.
-	//
+	// copy up to the end of the buffer, then the rest at the start
 
-	for(;;) {
+	first = SIO_BUF_SIZE - at;
+	if( first > (uint32_t) len ) {
+		first = len;
+	}
+	_memcpy( (uint8_t *) ring->buf + at, (uint8_t *) buf, first );
+	_memcpy( (uint8_t *) ring->buf, (uint8_t *) buf + first, len - first );
 
-		// get the "pending event" indicator
-		eir = __inb( UA4_EIR ) & UA4_EIR_INT_PRI_MASK;
+	ring->head += len;
 
-		// process this event
-		switch( eir ) {
+	return( len );
+}
 
-		   case UA4_EIR_LINE_STATUS_INT_PENDING:
-			// shouldn't happen, but just in case....
-			lsr = __inb( UA4_LSR );
-			c_printf( "** SIO line status, LSR = %02x\n", lsr );
-			break;
+/*
+** _ring_get(ring,buf,len)
+**
+** take up to 'len' characters from 'ring' into 'buf'
+**
+** returns the number of characters taken
+*/
 
-		   case UA4_EIR_RX_INT_PENDING:
-			// get the character
-			ch = __inb( UA4_RXD );
-			if( ch == '\r' ) {	// map CR to LF
-				ch = '\n';
-			}
+static int _ring_get( sio_ring_t *ring, char *buf, int len ) {
+	uint32_t count = ring->head - ring->tail;
+	uint32_t at = ring->tail & SIO_BUF_MASK;
+	uint32_t first;
+
+	if( (uint32_t) len > count ) {
+		len = count;
+	}
+
+	first = SIO_BUF_SIZE - at;
+	if( first > (uint32_t) len ) {
+		first = len;
+	}
+	_memcpy( (uint8_t *) buf, (uint8_t *) ring->buf + at, first );
+	_memcpy( (uint8_t *) buf + first, (uint8_t *) ring->buf, len - first );
+
+	ring->tail += len;
 
-			//
-			// Add to the input buffer
-			// if there is room, otherwise just ignore it.
-			//
+	return( len );
+}
+
+/*
+** _port_enable(port,which)
+**
+** enable interrupts on a port according to the 'which' parameter
+**
+** returns the prior settings
+*/
 
-			if( _incount < BUF_SIZE ) {
-				*_inlast++ = ch;
-				++_incount;
+static uint8_t _port_enable( sio_port_t *port, uint8_t which ) {
+	uint8_t old = port->ier;
+
+	if( which & SIO_TX ) {
+		port->ier |= UA4_IER_TX_INT_ENABLE;
+	}
+
+	if( which & SIO_RX ) {
+		port->ier |= UA4_IER_RX_INT_ENABLE;
+	}
+
+	if( old != port->ier ) {
+		__outb( REG(port,UA4_IER), port->ier );
+	}
+
+	return( old );
+}
+
+/*
+** _port_disable(port,which)
+**
+** disable interrupts on a port according to the 'which' parameter
+**
+** returns the prior settings
+*/
+
+static uint8_t _port_disable( sio_port_t *port, uint8_t which ) {
+	uint8_t old = port->ier;
+
+	if( which & SIO_TX ) {
+		port->ier &= ~UA4_IER_TX_INT_ENABLE;
+	}
+
+	if( which & SIO_RX ) {
+		port->ier &= ~UA4_IER_RX_INT_ENABLE;
+	}
+
+	if( old != port->ier ) {
+		__outb( REG(port,UA4_IER), port->ier );
+	}
+
+	return( old );
+}
+
+/*
+** _port_drain(port)
+**
+** move everything in the receiver FIFO into the input buffer
+**
+** returns non-zero if any characters were added to the buffer
+*/
+
+static int _port_drain( sio_port_t *port ) {
+	int lsr, ch;
+	int added = 0;
+
+	while( (lsr = __inb(REG(port,UA4_LSR))) & UA4_LSR_RXDA ) {
+
+		// note any errors
+
+		if( lsr & (UA4_LSR_OE | UA4_LSR_PE | UA4_LSR_FE) ) {
+			++port->stats.errors;
+			_klog( KLOG_DEBUG, "%s line status, LSR = %02x",
+			       port->device.name, lsr );
+		}
+
+		// get the character
+		ch = __inb( REG(port,UA4_RXD) );
+		++port->stats.rx;
+		if( ch == '\r' ) {	// map CR to LF
+			ch = '\n';
+		}
+
+		//
+		// Add to the input buffer
+		// if there is room, otherwise just ignore it.
+		//
+
+		if( _ring_count(&port->in) < SIO_BUF_SIZE ) {
+			port->in.buf[ port->in.head & SIO_BUF_MASK ] = ch;
+			++port->in.head;
+			added = 1;
+		} else {
+			++port->stats.dropped;
+		}
+	}
+
+	return( added );
+}
+
+/*
+** _port_send(port)
+**
+** move as many characters from the output buffer to the (empty)
+** transmitter as it can take
+*/
+
+static void _port_send( sio_port_t *port ) {
+	sio_ring_t *out = &port->out;
+	int n;
+
+	for( n = 0; n < port->tx_burst && _ring_count(out) > 0; ++n ) {
+		__outb( REG(port,UA4_TXD), out->buf[ out->tail & SIO_BUF_MASK ] );
+		++out->tail;
+	}
+
+	port->stats.tx += n;
+}
+
+/*
+** _port_poll_send(port,ch)
+**
+** wait for the transmitter to be ready, and send one character
+*/
+
+static void _port_poll_send( sio_port_t *port, char ch ) {
+
+	while( (__inb(REG(port,UA4_LSR)) & UA4_LSR_TXRDY) == 0 ) {
+		continue;
+	}
+	__outb( REG(port,UA4_TXD), ch );
+}
+
+/*
+** _port_start(port)
+**
+** start a transmit sequence if one isn't already under way
+*/
+
+static void _port_start( sio_port_t *port ) {
+	uint32_t flags;
+
+	flags = _int_disable();
+
+	if( !port->sending && _ring_count(&port->out) > 0 ) {
+
+		// prime the pump, and expect an interrupt when it's done
+
+		port->sending = 1;
+		_port_send( port );
+		_port_enable( port, SIO_TX );
+	}
+
+	_int_restore( flags );
+}
+
+/*
+** _port_write(port,buf,len)
+**
+** add up to 'len' characters to the output buffer, and get them moving
+**
+** Interrupts are held off while adding them, as the TX ISR also adds
+** characters (in _port_resume()).
+**
+** returns the number of characters added
+*/
+
+static int _port_write( sio_port_t *port, char *buf, int len ) {
+	uint32_t flags;
+	int copied;
+
+	flags = _int_disable();
+
+	copied = _ring_put( &port->out, buf, len );
+
+	_port_start( port );
+
+	_int_restore( flags );
+
+	return( copied );
+}
+
+/*
+** _port_copy_out(port,buf,count)
+**
+** add as many of 'count' characters from 'buf' to the output buffer
+** as will fit
+**
+** Runs of characters go into the output buffer a block at a time;
+** newlines are mapped to CR-LF, as _sio_writec() does.
+**
+** returns the count of characters accepted
+*/
+
+static int _port_copy_out( sio_port_t *port, char *buf, int count ) {
+	int n = 0;
+	int len, done;
+
+	while( n < count ) {
+
+		// find the next run of ordinary characters
+
+		for( len = 0; n + len < count && buf[n + len] != '\n'; ++len ) {
+			continue;
+		}
+
+		if( len > 0 ) {
+			done = _port_write( port, buf + n, len );
+			n += done;
+			if( done < len ) {	// output buffer is full
+				break;
 			}
-			break;
+		}
 
-		   case UA5_EIR_RX_FIFO_TIMEOUT_INT_PENDING:
-			// shouldn't happen, but just in case....
-			ch = __inb( UA4_RXD );
-			c_printf( "** SIO FIFO timeout, RXD = %02x\n", ch );
-			break;
+		// if we stopped at a newline, send it (all or nothing)
 
-		   case UA4_EIR_TX_INT_PENDING:
-			// if there is another character, send it
-			if( _sending && _outcount > 0 ) {
-				__outb( UA4_TXD, *_outnext );
-				++_outnext;
-				// wrap around if necessary
-				if( _outnext >= (_outbuffer + BUF_SIZE) ) {
-					_outnext = _outbuffer;
-				}
-				--_outcount;
-			} else {
-				// no more data - reset the output vars
-				_outcount = 0;
-				_outlast = _outnext = _outbuffer;
-				_sending = 0;
-				// disable TX interrupts
-				_sio_disable( SIO_TX );
+		if( n < count ) {
+			if( SIO_BUF_SIZE - _ring_count(&port->out) < 2 ) {
+				break;
 			}
-			break;
+			_port_write( port, "\r\n", 2 );
+			++n;
+		}
+
+	}
+
+	return( n );
+}
+
+/*
+** _port_resume(port)
+**
+** called when the output buffer has drained to the low-water mark:
+** continue the writes of blocked processes, in order, waking each
+** one as its write completes
+**
+** The remaining part of a blocked write is kept in the writer's
+** syscall arguments, and the count written so far in its return
+** value.
+*/
+
+static void _port_resume( sio_port_t *port ) {
+	pcb_t *pcb;
+	char *buf;
+	int count, n;
+
+	while( !_queue_empty(port->writers) ) {
+
+		pcb = (pcb_t *) _queue_dpeek( port->writers );
+		buf = (char *) ARG(2,pcb->context);
+		count = (int) ARG(3,pcb->context);
 
-		   case UA4_EIR_NO_INT:
-			// nothing to do - tell the PIC we're done
-			__outb( PIC_MASTER_CMD_PORT, PIC_EOI );
+		n = _port_copy_out( port, buf, count );
+		RET(pcb->context) += n;
+
+		if( n < count ) {
+			// full again - wait for the next time
+			ARG(2,pcb->context) = (uint32_t) (buf + n);
+			ARG(3,pcb->context) = count - n;
 			return;
+		}
 
-		   case UA4_EIR_MODEM_STATUS_INT_PENDING:
-			// shouldn't happen, but just in case....
-			msr = __inb( UA4_MSR );
-			c_printf( "** SIO modem status, MSR = %02x\n", msr );
-			break;
+		_queue_remove( port->writers );
+		_schedule( pcb );
+	}
+}
+
+/*
+** _port_apply(port)
+**
+** program the UART with the current line settings
+**
+** Called when no output is buffered.  Waits for the last character
+** to leave the transmitter, and moves anything received at the old
+** settings into the input buffer first.
+**
+** returns non-zero if any characters were added to the input buffer
+*/
 
-		   default:
-			// make sure the code prints
-			_kpanic( "_sio_isr", "unknown device status" );
+static int _port_apply( sio_port_t *port ) {
+	int added;
 
+	for( int i = 0; i < SIO_TXEMP_SPINS; ++i ) {
+		if( __inb(REG(port,UA4_LSR)) & UA4_LSR_TXEMP ) {
+			break;
 		}
+	}
+
+	added = _port_drain( port );
+
+	/*
+	** select bank 1 and set the data rate
+	*/
+
+	__outb( REG(port,UA4_LCR), UA4_LCR_BANK1 );
+	__outb( REG(port,UA4_LBGD_L), BAUD_LOW_BYTE( port->divisor ) );
+	__outb( REG(port,UA4_LBGD_H), BAUD_HIGH_BYTE( port->divisor ) );
+
+	/*
+	** Select bank 0, and at the same time set the LCR for our
+	** data characteristics.
+	*/
+
+	__outb( REG(port,UA4_LCR), UA4_LCR_BANK0 | port->line );
 
+	return( added );
+}
+
+/*
+** _port_change(port)
+**
+** make a pending line settings change, and release the process
+** waiting for it (if any)
+*/
+
+static void _port_change( sio_port_t *port ) {
+
+	port->divisor = port->new_divisor;
+	port->line = port->new_line;
+	if( _port_apply(port) ) {
+		_dev_notify( &port->device );
 	}
 
-	// should never reach this point!
+	if( port->change_wait != NULL ) {
+		_schedule( port->change_wait );
+		port->change_wait = NULL;
+	}
+}
+
+/*
+** _port_service(port,eir)
+**
+** handle one pending event on a port, as described by the value
+** 'eir' read from its event identification register
+**
+** With the FIFOs enabled, one receive interrupt (at the trigger
+** level, or on a timeout with fewer characters waiting) drains the
+** whole receiver FIFO, and one transmit interrupt refills the whole
+** (empty) transmitter FIFO.
+**
+** returns non-zero if pollers should be told about a change
+*/
 
-	_kpanic( "_sio_isr", "infinite loop ended???" );
+static int _port_service( sio_port_t *port, int eir ) {
+	uint32_t before;
+	int notify = 0;
 
+	// process this event
+	switch( eir & UA4_EIR_INT_PRI_MASK ) {
+
+	   case UA4_EIR_LINE_STATUS_INT_PENDING:
+		// shouldn't happen, but just in case....
+		_klog( KLOG_WARN, "%s line status, LSR = %02x",
+		       port->device.name, __inb(REG(port,UA4_LSR)) );
+		break;
+
+	   case UA4_EIR_RX_INT_PENDING:
+	   case UA5_EIR_RX_FIFO_TIMEOUT_INT_PENDING:
+		// take everything that has arrived
+		if( _port_drain(port) ) {
+			notify = 1;
+		}
+		break;
+
+	   case UA4_EIR_TX_INT_PENDING:
+		// if there are more characters, send them
+		if( port->sending && _ring_count(&port->out) > 0 ) {
+			before = _ring_count( &port->out );
+			_port_send( port );
+			// on reaching the low-water mark, let writers
+			// continue and pollers know
+			if( before > SIO_LOW_WATER &&
+			    _ring_count(&port->out) <= SIO_LOW_WATER ) {
+				_port_resume( port );
+				notify = 1;
+			}
+		} else {
+			// no more data
+			port->sending = 0;
+			// disable TX interrupts
+			_port_disable( port, SIO_TX );
+			// make any pending line settings change
+			if( port->change_wait != NULL ) {
+				_port_change( port );
+			}
+		}
+		break;
+
+	   case UA4_EIR_NO_INT:
+		break;
+
+	   case UA4_EIR_MODEM_STATUS_INT_PENDING:
+		// shouldn't happen, but just in case....
+		_klog( KLOG_WARN, "%s modem status, MSR = %02x",
+		       port->device.name, __inb(REG(port,UA4_MSR)) );
+		break;
+
+	   default:
+		// make sure the code prints
+		_kpanic( "_sio_isr", "unknown device status" );
+
+	}
+
+	return( notify );
 }
 
 /*
-** _sio_modinit()
+** _port_init(port)
+**
+** look for a port, and initialize it if it is there
 **
-** Initialize the UART chip.
+** returns non-zero if the port is present
 */
-void _sio_modinit( void ) {
+
+static int _port_init( sio_port_t *port ) {
 
 	/*
 	** Initialize SIO variables.
 	*/
 
-	_memset( (void *) _inbuffer, sizeof(_inbuffer), 0 );
-	_inlast = _innext = _inbuffer;
-	_incount = 0;
+	port->in.head = port->in.tail = 0;
+	port->out.head = port->out.tail = 0;
+	port->sending = 0;
+	port->nonblock = 0;
+	port->change_wait = NULL;
+	_memset( (uint8_t *) &port->stats, sizeof(port->stats), 0 );
 
-	_memset( (void *) _outbuffer, sizeof(_outbuffer), 0 );
-	_outlast = _outnext = _outbuffer;
-	_outcount = 0;
-	_sending = 0;
+	/*
+	** See if there is a UART there:  the scratch register of a
+	** missing one won't hold a value
+	*/
+
+	__outb( REG(port,UA4_UA5_SCR), 0x5a );
+	if( __inb(REG(port,UA4_UA5_SCR)) != 0x5a ) {
+		return( 0 );
+	}
+	__outb( REG(port,UA4_UA5_SCR), 0xa5 );
+	if( __inb(REG(port,UA4_UA5_SCR)) != 0xa5 ) {
+		return( 0 );
+	}
+
+	if( _queue_alloc(&port->writers,1) != 1 || port->writers == NULL ) {
+		_kpanic( "_sio_modinit", "can't allocate writer queue" );
+	}
+	_queue_init( port->writers, NULL );
 
 	/*
 	** Next, initialize the UART.
@@ -239,14 +750,27 @@ void _sio_modinit( void ) {
 	** this is a bizarre little sequence of operations
 	*/
 
-	__outb( UA4_FCR, 0x20 );
-	__outb( UA4_FCR, UA5_FCR_FIFO_RESET );	// 0x00
-	__outb( UA4_FCR, UA5_FCR_FIFO_EN );	// 0x01
-	__outb( UA4_FCR, UA5_FCR_FIFO_EN |
+	__outb( REG(port,UA4_FCR), 0x20 );
+	__outb( REG(port,UA4_FCR), UA5_FCR_FIFO_RESET );	// 0x00
+	__outb( REG(port,UA4_FCR), UA5_FCR_FIFO_EN );	// 0x01
+	__outb( REG(port,UA4_FCR), UA5_FCR_FIFO_EN |
 			 UA5_FCR_RXSR );	// 0x03
-	__outb( UA4_FCR, UA5_FCR_FIFO_EN |
+	__outb( REG(port,UA4_FCR), UA5_FCR_FIFO_EN |
 			 UA5_FCR_RXSR |
-			 UA5_FCR_TXSR );	// 0x07
+			 UA5_FCR_TXSR |
+			 SIO_RX_TRIGGER );	// 0x07 + trigger
+
+	/*
+	** An 8250 or 16450 has no FIFOs (and reports none in the
+	** EIR), so it can only take one character at a time
+	*/
+
+	if( (__inb(REG(port,UA4_EIR)) & (UA5_EIR_FEN0 | UA5_EIR_FEN1)) ==
+	    (UA5_EIR_FEN0 | UA5_EIR_FEN1) ) {
+		port->tx_burst = SIO_TX_FIFO;
+	} else {
+		port->tx_burst = 1;
+	}
 
 	/*
 	** disable interrupts
@@ -255,38 +779,281 @@ void _sio_modinit( void ) {
 	** called to switch them back on
 	*/
 
-	__outb( UA4_IER, 0 );
-	_ier = 0;
+	__outb( REG(port,UA4_IER), 0 );
+	port->ier = 0;
 
 	/*
-	** select bank 1 and set the data rate
+	** set the data rate and line format
 	*/
 
-	__outb( UA4_LCR, UA4_LCR_BANK1 );
-	__outb( UA4_LBGD_L, BAUD_LOW_BYTE( BAUD_9600 ) );
-	__outb( UA4_LBGD_H, BAUD_HIGH_BYTE( BAUD_9600 ) );
+	port->divisor = SIO_BASE_BAUD / SIO_DEFAULT_BAUD;
+	port->line = SIO_DEFAULT_LINE;
+	_port_apply( port );
 
 	/*
-	** Select bank 0, and at the same time set the LCR for our
-	** data characteristics.
+	** Set the ISEN bit to enable the interrupt request signal.
 	*/
 
-	__outb( UA4_LCR, UA4_LCR_BANK0 |
-			 UA4_LCR_BITS_8 |
-			 UA4_LCR_1_STOP_BIT |
-			 UA4_LCR_NO_PARITY );
+	__outb( REG(port,UA4_MCR), UA4_MCR_ISEN | UA4_MCR_DTR | UA4_MCR_RTS );
 
-	/*
-	** Set the ISEN bit to enable the interrupt request signal.
-	*/
+	return( 1 );
+}
+
+/*
+** _sio_dev_read(dev,buf,count)
+**
+** device read operation:  take whatever input is buffered
+*/
+
+static int _sio_dev_read( device_t *dev, char *buf, int count ) {
+	sio_port_t *port = (sio_port_t *) dev->data;
+
+	return( _ring_get(&port->in,buf,count) );
+}
+
+/*
+** _sio_dev_write(dev,buf,count)
+**
+** device write operation
+**
+** In blocking mode (the default), a write which doesn't fit in the
+** output buffer blocks the calling process until all of it has been
+** buffered.  In nonblocking mode, the write takes whatever fits.
+**
+** returns the count of characters accepted
+*/
+
+static int _sio_dev_write( device_t *dev, char *buf, int count ) {
+	sio_port_t *port = (sio_port_t *) dev->data;
+	pcb_t *pcb = _current;
+	int n = 0;
+
+	// writers already waiting go first
+
+	if( _queue_empty(port->writers) ) {
+		n = _port_copy_out( port, buf, count );
+	}
+
+	if( n == count || port->nonblock ) {
+		return( n );
+	}
+
+	// block until the TX ISR finds room for the rest
+
+	ARG(2,pcb->context) = (uint32_t) (buf + n);
+	ARG(3,pcb->context) = count - n;
+	pcb->state = STATE_BLOCKED;
+	_queue_insert( port->writers, (void *) pcb, NULL );
+	_dispatch();
+
+	return( n );
+}
+
+/*
+** _sio_dev_poll(dev)
+**
+** device poll operation
+*/
+
+static int _sio_dev_poll( device_t *dev ) {
+	sio_port_t *port = (sio_port_t *) dev->data;
+	int events = 0;
+
+	if( _ring_count(&port->in) > 0 ) {
+		events |= POLLIN;
+	}
+
+	if( _ring_count(&port->out) < SIO_BUF_SIZE ) {
+		events |= POLLOUT;
+	}
+
+	return( events );
+}
 
-	__outb( UA4_MCR, UA4_MCR_ISEN | UA4_MCR_DTR | UA4_MCR_RTS );
+/*
+** _sio_dev_ioctl(dev,request,arg)
+**
+** device control operation:  change the bit rate or line format,
+** select nonblocking writes, or fetch the port statistics
+**
+** A settings change is made once the output buffer has drained;
+** until then, the calling process is blocked.  Only one change can
+** be pending at a time.
+**
+** returns 0 on success, or -1 on error
+*/
+
+static int _sio_dev_ioctl( device_t *dev, int request, uint32_t arg ) {
+	sio_port_t *port = (sio_port_t *) dev->data;
+	uint32_t divisor;
+
+	if( request == IOC_SIO_NBIO ) {
+		port->nonblock = (arg != 0);
+		return( 0 );
+	}
+
+	if( request == IOC_SIO_STATS ) {
+		if( arg == 0 ) {
+			return( -1 );
+		}
+		*(sio_stats_t *) arg = port->stats;
+		return( 0 );
+	}
+
+	if( port->change_wait != NULL ) {
+		return( -1 );
+	}
+
+	port->new_divisor = port->divisor;
+	port->new_line = port->line;
+
+	switch( request ) {
+
+	case IOC_SIO_BAUD:
+		// the nearest divisor must give a rate within 3%
+		if( arg == 0 || arg > SIO_BASE_BAUD ) {
+			return( -1 );
+		}
+		divisor = (SIO_BASE_BAUD + arg / 2) / arg;
+		if( divisor > 0xffff ||
+		    (SIO_BASE_BAUD / divisor) * 100 < arg * 97 ||
+		    (SIO_BASE_BAUD / divisor) * 100 > arg * 103 ) {
+			return( -1 );
+		}
+		port->new_divisor = divisor;
+		break;
+
+	case IOC_SIO_LINE:
+		if( arg & ~(SIO_DATA_8 | SIO_STOP_2 | SIO_PARITY_SPACE) ) {
+			return( -1 );
+		}
+		port->new_line = arg;
+		break;
+
+	default:
+		return( -1 );
+	}
+
+	if( !port->sending ) {
+		_port_change( port );
+		return( 0 );
+	}
+
+	// wait for the TX ISR to find the buffer empty
+
+	port->change_wait = _current;
+	_current->state = STATE_BLOCKED;
+	_dispatch();
+
+	return( 0 );
+}
+
+/*
+** _sio_isr(vector,code)
+**
+** Interrupt handler for the SIO module.  Services every port on
+** the interrupting line, one event at a time, until none of them
+** has anything pending.
+*/
+
+static void _sio_isr( int vector, int code ) {
+	(void)(code);
+
+	uint8_t notify[ N_SIO_PORTS ];
+	int busy, eir;
+	int i;
+
+	for( i = 0; i < N_SIO_PORTS; ++i ) {
+		notify[i] = 0;
+	}
+
+	//
+	// A port which raises an interrupt while another is being
+	// serviced would otherwise be missed, so keep going around
+	// until a pass finds nothing to do.
+	//
+
+	do {
+		busy = 0;
+		for( i = 0; i < N_SIO_PORTS; ++i ) {
+			sio_port_t *port = &_ports[i];
+
+			if( !port->present || port->vector != vector ) {
+				continue;
+			}
+			// reading the EIR clears a TX event, so the
+			// value read here is the one to handle
+			eir = __inb( REG(port,UA4_EIR) );
+			if( eir & UA4_EIR_IPF ) {
+				continue;	// nothing pending
+			}
+			busy = 1;
+			++port->stats.interrupts;
+			if( _port_service(port,eir) ) {
+				notify[i] = 1;
+			}
+		}
+	} while( busy );
+
+	// nothing to do - tell the PIC we're done
+
+	__outb( PIC_MASTER_CMD_PORT, PIC_EOI );
+
+	// and tell any pollers what has changed
+
+	for( i = 0; i < N_SIO_PORTS; ++i ) {
+		if( notify[i] ) {
+			_dev_notify( &_ports[i].device );
+		}
+	}
+}
+
+/*
+** PUBLIC FUNCTIONS
+*/
+
+/*
+** _sio_modinit()
+**
+** Initialize the UART chips.
+*/
+void _sio_modinit( void ) {
+
+	for( int i = 0; i < N_SIO_PORTS; ++i ) {
+		sio_port_t *port = &_ports[i];
+
+		port->base = _port_config[i].base;
+		port->vector = _port_config[i].vector;
+		port->devnum = _port_config[i].devnum;
+		port->device.name = _port_config[i].name;
+		port->device.read = _sio_dev_read;
+		port->device.write = _sio_dev_write;
+		port->device.poll = _sio_dev_poll;
+		port->device.ioctl = _sio_dev_ioctl;
+		port->device.data = (void *) port;
+
+		port->present = _port_init( port );
+		if( !port->present ) {
+			continue;
+		}
+
+		/*
+		** Plug into the device switch
+		*/
+
+		if( _dev_register(port->devnum,&port->device) < 0 ) {
+			_kpanic( "_sio_modinit", "can't register SIO device" );
+		}
+
+		c_printf( " %s", port->device.name );
+	}
 
 	/*
-	** Install our ISR
+	** Install our ISR for both lines
 	*/
 
 	__install_isr( INT_VEC_SERIAL_PORT_1, _sio_isr );
+	__install_isr( INT_VEC_SERIAL_PORT_2, _sio_isr );
 
 	/*
 	** Report that we're done.
@@ -303,36 +1070,21 @@ void _sio_modinit( void ) {
 **
 ** usage:	old = _sio_enable( which )
 **
-** enables interrupts according to the 'which' parameter
+** enables interrupts on every port according to the 'which'
+** parameter
 **
-** returns the prior settings
+** returns the prior settings (of COM1)
 */
 
 uint8_t _sio_enable( uint8_t which ) {
-	uint8_t old;
-
-	// remember the current status
-
-	old = _ier;
-
-	// figure out what to enable
-
-	if( which & SIO_TX ) {
-		_ier |= UA4_IER_TX_INT_ENABLE;
-	}
+	uint8_t old = _com1->ier;
 
-	if( which & SIO_RX ) {
-		_ier |= UA4_IER_RX_INT_ENABLE;
-	}
-
-	// if there was a change, make it
-
-	if( old != _ier ) {
-		__outb( UA4_IER, _ier );
+	for( int i = 0; i < N_SIO_PORTS; ++i ) {
+		if( _ports[i].present ) {
+			_port_enable( &_ports[i], which );
+		}
 	}
 
-	// return the prior settings
-
 	return( old );
 }
 
@@ -343,36 +1095,21 @@ uint8_t _sio_enable( uint8_t which ) {
 **
 ** usage:	old = _sio_disable( which )
 **
-** disables interrupts according to the 'which' parameter
+** disables interrupts on every port according to the 'which'
+** parameter
 **
-** returns the prior settings
+** returns the prior settings (of COM1)
 */
 
 uint8_t _sio_disable( uint8_t which ) {
-	uint8_t old;
-
-	// remember the current status
-
-	old = _ier;
-
-	// figure out what to disable
-
-	if( which & SIO_TX ) {
-		_ier &= ~UA4_IER_TX_INT_ENABLE;
-	}
+	uint8_t old = _com1->ier;
 
-	if( which & SIO_RX ) {
-		_ier &= ~UA4_IER_RX_INT_ENABLE;
-	}
-
-	// if there was a change, make it
-
-	if( old != _ier ) {
-		__outb( UA4_IER, _ier );
+	for( int i = 0; i < N_SIO_PORTS; ++i ) {
+		if( _ports[i].present ) {
+			_port_disable( &_ports[i], which );
+		}
 	}
 
-	// return the prior settings
-
 	return( old );
 }
 
@@ -387,7 +1124,7 @@ uint8_t _sio_disable( uint8_t which ) {
 */
 
 int _sio_input_queue( void ) {
-	return( _incount );
+	return( _ring_count(&_com1->in) );
 }
 
 /*
@@ -401,30 +1138,13 @@ int _sio_input_queue( void ) {
 */
 
 int _sio_readc( void ) {
-	int ch;
-
-	// assume there is no character available
-	ch = -1;
-
-	//
-	// If there is a character, return it
-	//
-
-	if( _incount > 0 ) {
-
-		// take it out of the input buffer
-		ch = ((int)(*_innext++)) & 0xff;
-		--_incount;
-
-		// reset the buffer variables if this was the last one
-		if( _incount < 1 ) {
-			_inlast = _innext = _inbuffer;
-		}
+	char ch;
 
+	if( _ring_get(&_com1->in,&ch,1) < 1 ) {
+		return( -1 );
 	}
 
-	return( ch );
-
+	return( ((int) ch) & 0xff );
 }
 
 /*
@@ -436,38 +1156,10 @@ int _sio_readc( void ) {
 */
 
 int _sio_reads( char *buf, int length ) {
-	char *ptr = buf;
-	int copied = 0;
-
-	// if there are no characters, just return 0
-
-	if( _incount < 1 ) {
-		return( 0 );
-	}
-
-	//
-	// We have characters.  Copy as many of them into the user
-	// buffer as will fit.
-	//
-
-	while( _incount > 0 && copied < length ) {
-		*ptr++ = *_innext++ & 0xff;
-		if( _innext > (_inbuffer + BUF_SIZE) ) {
-			_innext = _inbuffer;
-		}
-		--_incount;
-		++copied;
-	}
 
-	// reset the input buffer if necessary
+	// copy as many as will fit (in at most two blocks)
 
-	if( _incount < 1 ) {
-		_inlast = _innext = _inbuffer;
-	}
-
-	// return the copy count
-
-	return( copied );
+	return( _ring_get(&_com1->in,buf,length) );
 }
 
 
@@ -477,9 +1169,12 @@ int _sio_reads( char *buf, int length ) {
 ** write a character to the serial output
 **
 ** usage:	_sio_writec( ch )
+**
+** the character is dropped if the output buffer is full
 */
 
 void _sio_writec( int ch ){
+	char c = ch;
 
 	//
 	// Must do LF -> CRLF mapping
@@ -489,26 +1184,7 @@ void _sio_writec( int ch ){
 		_sio_writec( '\r' );
 	}
 
-	//
-	// If we're currently transmitting, just add this to the buffer
-	//
-
-	if( _sending ) {
-		*_outlast++ = ch;
-		++_outcount;
-		return;
-	}
-
-	//
-	// Not sending - must prime the pump
-	//
-
-	_sending = 1;
-	__outb( UA4_TXD, ch );
-
-	// Also must enable transmitter interrupts
-
-	_sio_enable( SIO_TX );
+	_port_write( _com1, &c, 1 );
 
 }
 
@@ -521,45 +1197,10 @@ void _sio_writec( int ch ){
 */
 
 int _sio_writes( char *buffer, int length ) {
-	int first = *buffer;
-	char *ptr = buffer;
-	int copied = 0;
-
-	//
-	// If we are currently sending, we want to append all
-	// the characters to the output buffer; else, we want
-	// to append all but the first character, and then use
-	// _sio_writec() to send the first one out.
-	//
-
-	if( !_sending ) {
-		ptr += 1;
-		copied++;
-	}
-
-	while( copied < length && _outcount < BUF_SIZE ) {
-		*_outlast++ = *ptr++;
-		// wrap around if necessary
-		if( _outlast >= (_outbuffer + BUF_SIZE) ) {
-			_outlast = _outbuffer;
-		}
-		++_outcount;
-		++copied;
-	}
-
-	//
-	// We use _sio_writec() to send out the first character,
-	// as it will correctly set all the other necessary
-	// variables for us.
-	//
-
-	if( !_sending ) {
-		_sio_writec( first );
-	}
 
-	// Return the transfer count
+	// add what will fit, and get it moving
 
-	return( copied );
+	return( _port_write(_com1,buffer,length) );
 
 }
 
@@ -583,31 +1224,73 @@ int _sio_puts( char *buffer ) {
 	return( n );
 }
 
+/*
+** _sio_panic_puts( buf )
+**
+** write a NUL-terminated buffer of characters to the serial output
+** by polling the transmitter, after any output still buffered
+**
+** For _kpanic():  this works with interrupts disabled, and never
+** waits for the ISR.  Newlines are mapped to CR-LF.
+*/
+
+void _sio_panic_puts( char *buffer ) {
+	sio_port_t *port = _com1;
+	sio_ring_t *out = &port->out;
+
+	if( !port->present ) {
+		return;
+	}
+
+	// the ring already has its newlines mapped
+
+	while( _ring_count(out) > 0 ) {
+		_port_poll_send( port, out->buf[ out->tail & SIO_BUF_MASK ] );
+		++out->tail;
+	}
+
+	for( ; *buffer != '\0'; ++buffer ) {
+		if( *buffer == '\n' ) {
+			_port_poll_send( port, '\r' );
+		}
+		_port_poll_send( port, *buffer );
+	}
+}
+
 /*
 ** _sio_dump()
 **
-** dump the contents of the SIO buffers
+** dump the contents of the SIO buffers, and the port statistics
 */
 
 void _sio_dump( void ) {
-	int n;
-	char *ptr;
-
-	c_printf( "SIO buffers:  in %d ot %d\n", _incount, _outcount );
-	if( _incount ) {
-		c_puts( " in: \"" );
-		ptr = _innext;
-		for( n = 0; (unsigned)n < _incount; ++n )
-			_put_char_or_code( *ptr++ );
-		c_puts( "\"\n" );
-	}
-
-	if( _outcount ) {
-		c_puts( " ot: \"" );
-		ptr = _outnext;
-		for( n = 0; (unsigned)n < _outcount; ++n )
-			_put_char_or_code( *ptr++ );
-		c_puts( "\"\n" );
+	sio_port_t *port;
+	uint32_t n;
+
+	for( int i = 0; i < N_SIO_PORTS; ++i ) {
+		port = &_ports[i];
+		if( !port->present ) {
+			continue;
+		}
+
+		c_printf( "%s:  in %d ot %d  rx %d tx %d drop %d err %d int %d\n",
+			  port->device.name, _ring_count(&port->in),
+			  _ring_count(&port->out), port->stats.rx,
+			  port->stats.tx, port->stats.dropped,
+			  port->stats.errors, port->stats.interrupts );
+		if( _ring_count(&port->in) ) {
+			c_puts( " in: \"" );
+			for( n = port->in.tail; n != port->in.head; ++n )
+				_put_char_or_code( port->in.buf[n & SIO_BUF_MASK] );
+			c_puts( "\"\n" );
+		}
+
+		if( _ring_count(&port->out) ) {
+			c_puts( " ot: \"" );
+			for( n = port->out.tail; n != port->out.head; ++n )
+				_put_char_or_code( port->out.buf[n & SIO_BUF_MASK] );
+			c_puts( "\"\n" );
+		}
 	}
 
 }
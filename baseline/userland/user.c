@@ -51,6 +51,8 @@ void user_s( void ); void user_t( void ); void user_u( void );
 void user_v( void ); void user_w( void ); void user_x( void );
 void user_y( void ); void user_z( void );
 void user_net( void );
+void user_prof( void );
+void user_dmesg( void );
 
 /*
 ** Users A, B, and C are identical, except for the character they
@@ -472,19 +474,11 @@ void user_r( void ) {
 */
 
 void user_x( void ) {
-	int i, j;
 	int pid, ppid;
-	char buf1[16], buf2[16];
 
 	pid = get_process_info( INFO_PID, 0 );
 	ppid = get_process_info( INFO_PPID, 0 );
-	i = itos10( buf1, pid );
-	j = itos10( buf2, ppid );
-	write( FD_CONSOLE, "User X running, PID ", 0 );
-	write( FD_CONSOLE, buf1, i );
-	write( FD_CONSOLE, " PPID ", 0 );
-	write( FD_CONSOLE, buf2, j );
-	write( FD_CONSOLE, "\n", 1 );
+	printf( "User X running, PID %d PPID %d\n", pid, ppid );
 
 	for( int k = 0; k < 20 ; ++k ) {
 		write( FD_SIO, "X", 1 );
@@ -492,11 +486,7 @@ void user_x( void ) {
 			continue;
 	}
 
-	write( FD_CONSOLE, "User X exiting, PID ", 0 );
-	write( FD_CONSOLE, buf1, i );
-	write( FD_CONSOLE, " PPID ", 0 );
-	write( FD_CONSOLE, buf2, j );
-	write( FD_CONSOLE, "\n", 1 );
+	printf( "User X exiting, PID %d PPID %d\n", pid, ppid );
 	exit();
 
 }
@@ -580,6 +570,67 @@ void user_net( void ) {
     }
 }
 
+/*
+** User prof periodically copies the sampling profiler's dump to
+** the serial line, where it can be captured and fed to ProfSym on
+** the host.  The system must be built with PROFILE defined.
+*/
+
+void user_prof( void ) {
+	pollfd_t out;
+	char buf[ 256 ];
+	int n, done, len;
+
+	out.fd = FD_SIO;
+	out.events = POLLOUT;
+
+	for(;;) {
+
+		sleep( SECONDS_TO_MS(10) );
+
+		while( (n = read(FD_PROF,buf,sizeof(buf))) > 0 ) {
+
+			// the SIO may not take it all at once
+
+			for( done = 0; done < n; done += len ) {
+				len = write( FD_SIO, buf + done, n - done );
+				if( len < 0 ) {
+					write( FD_CONSOLE, "user prof: no SIO\n", 0 );
+					exit();
+				}
+				if( len < n - done ) {
+					poll( &out, 1, -1 );
+				}
+			}
+		}
+
+		if( n < 0 ) {
+			write( FD_CONSOLE, "user prof: no profiler\n", 0 );
+			exit();
+		}
+	}
+}
+
+/*
+** User dmesg prints the contents of the kernel log on the console,
+** including the records below the console's level, and exits.
+*/
+
+void user_dmesg( void ) {
+	char buf[ 256 ];
+	int n;
+
+	while( (n = read(FD_KLOG,buf,sizeof(buf))) > 0 ) {
+		write( FD_CONSOLE, buf, n );
+	}
+
+	if( n < 0 ) {
+		write( FD_CONSOLE, "user dmesg: no kernel log\n", 0 );
+	}
+
+	exit();
+}
+
 
 /*
 ** SYSTEM PROCESSES
@@ -767,6 +818,23 @@ void init( void ) {
 		exit();
 	}
 #endif
+
+#ifdef SPAWN_PROF
+	pid = spawnp( user_prof, PRIO_USER_LOW );
+	if( pid < 0 ) {
+		write( FD_CONSOLE, "init, spawnp() user prof failed\n", 0 );
+		exit();
+	}
+#endif
+
+#ifdef SPAWN_DMESG
+	// on its own console (Alt-F2)
+	pid = spawnc( user_dmesg, PRIO_USER_LOW, 1 );
+	if( pid < 0 ) {
+		write( FD_CONSOLE, "init, spawnc() user dmesg failed\n", 0 );
+		exit();
+	}
+#endif
 	write( FD_SIO, "!", 1 );
 
 	exit();